@@ -34,13 +34,13 @@ Conjunction::Conjunction() : tester(nullptr), _id(counter++) {}
 Conjunction Conjunction::Make(bool val) {
   Conjunction c;
   if (not val)
-    c.eqs.insert(&Constraint::falseC);
+    c.eqs.insert(Constraint::getFalse());
 
   return c;
 }
 
 Conjunction::Conjunction(const Symbols &v, const Symbols &p,
-                         const Constraints &e, const Constraints &i,
+                         const ConstraintSet &e, const ConstraintSet &i,
                          const unsigned id)
     : vars(v), pars(p), eqs(e), ineqs(i), tester(nullptr), _id(id) {
   ineqs.erase(Constraint::getTrue());
@@ -56,31 +56,10 @@ Conjunction::Conjunction(const Symbols &v, const Symbols &p,
     removeUnused();
   }
 
-  for (cc c : ineqs) {
-    if (ineqs.find(c->getNot()) != ineqs.end()) {
-      DEBUG(1, "This system contains to inverse constraints:"
-                   << c << " AND " << c->getNot() << NL);
-      makeFalse();
-      return;
-    }
-  }
-  for (cc c : ineqs) {
-    if (ineqs.find(c->getNot()) != ineqs.end()) {
-      DEBUG(1, "This system contains to inverse constraints:"
-                   << c << " AND " << c->getNot() << NL);
-      makeFalse();
-      return;
-    }
-  }
-
-  for (auto it1 = ineqs.begin(); it1 != ineqs.end(); it1++) {
-    cc c = *it1;
-    if (ineqs.find(c->getNot()) != ineqs.end()) {
-      DEBUG(1, "This system contains to inverse constraints:"
-                   << c << " AND " << c->getNot() << NL);
-      makeFalse();
-      return;
-    }
+  if (ineqs.hasComplementary()) {
+    DEBUG(1, "This system contains two inverse constraints\n");
+    makeFalse();
+    return;
   }
 }
 
@@ -294,9 +273,6 @@ void Conjunction::insert(const string &constraint) {
 }
 
 bool Conjunction::implies(const Conjunction &other) {
-  Constraints oeqs = other.eqs;
-  Constraints oineqs = other.ineqs;
-
   if (other == Conjunction::absurd) {
     return (*this == Conjunction::absurd);
   }
@@ -307,45 +283,32 @@ bool Conjunction::implies(const Conjunction &other) {
   if (*this == Conjunction::absurd)
     return false;
 
+  // The constraints of other that are not syntactically in this system
+  ConstraintSet ours = ineqs;
   for (cc eq : eqs) {
-    oeqs.erase(eq);
-    oineqs.erase(Constraint::get(eq->exp));
-    oineqs.erase(Constraint::get(-eq->exp));
+    ours.insert(Constraint::get(eq->exp));
+    ours.insert(Constraint::get(-eq->exp));
   }
-
-  for (cc eq : oeqs) {
+  ConstraintSet oineqs = other.ineqs;
+  for (cc eq : other.eqs - eqs) {
     oineqs.insert(Constraint::get(eq->exp));
     oineqs.insert(Constraint::get(-eq->exp));
   }
-
-  oeqs.clear();
-
-  for (cc v : ineqs) {
-    oineqs.erase(v);
-  }
+  oineqs -= ours;
 
   if (oineqs.empty())
     return true;
 
-  for (const ex &x : other.pars)
-    if (not(pars.has(x) or vars.has(x)))
-      return false;
-
-  for (const ex &x : other.vars)
-    if (not(pars.has(x) or vars.has(x)))
-      return false;
-
-  if ((not oineqs.empty()) && (tester == nullptr))
-    getTester();
+  if (not(pars | vars).includes(other.pars | other.vars))
+    return false;
 
-  while (not oineqs.empty()) {
-    Constraints::iterator tt = oineqs.begin();
-    auto res = tester->test((*tt)->exp);
+  SchweighoferTester *t = getTester();
+  for (cc tt : oineqs) {
+    auto res = t->test(tt->exp);
     switch (res.sign) {
     case SIGN::GEZ:
     case SIGN::GTZ:
     case SIGN::ZERO:
-      oineqs.erase(tt);
       continue;
     case SIGN::ABSURD: {
       DEBUG(1, "FALSE\n");
@@ -359,40 +322,39 @@ bool Conjunction::implies(const Conjunction &other) {
   return true;
 }
 
+Symbols Conjunction::usedSymbols() const {
+  Symbols used;
+  for (cc c : eqs)
+    used |= c->symbs;
+  for (cc c : ineqs)
+    used |= c->symbs;
+  return used;
+}
+
 void Conjunction::removeUnused() {
-  removeUnused(pars);
-  removeUnused(vars);
+  const Symbols used = usedSymbols();
+  pars &= used;
+  vars &= used;
 }
 
 void Conjunction::removeUnused(Symbols &toSimplify) {
-  toSimplify.sort();
-  toSimplify.unique();
-  Symbols remaining;
-  for (const ex &e : toSimplify) {
-    bool found = false;
-    for (cc c : eqs) {
-      if (quo(c->exp, e, e) != 0) {
-        remaining.append(e);
-        found = true;
-        break;
-      }
-    }
-    if (found)
-      continue;
-    for (cc c : ineqs) {
-      if (quo(c->exp, e, e) != 0) {
-        remaining.append(e);
-        found = true;
-        break;
-      }
-    }
-  }
-  swap(toSimplify, remaining);
+  toSimplify &= usedSymbols();
 }
 
 bool Conjunction::operator==(const Conjunction &other) const {
-  return ((vars == other.vars) and (pars == other.pars) and
-          (eqs == other.eqs) and (ineqs == other.ineqs));
+  return ((eqs == other.eqs) and (ineqs == other.ineqs) and
+          (vars == other.vars) and (pars == other.pars));
+}
+
+uint64_t Conjunction::hash() const {
+  uint64_t h = eqs.hash();
+  auto combine = [&h](uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  };
+  combine(ineqs.hash());
+  combine(vars.hash());
+  combine(pars.hash());
+  return h;
 }
 
 bool Conjunction::hasVariables() const { return (vars.nops() != 0); }
@@ -401,11 +363,8 @@ Conjunction Conjunction::operator&(const Conjunction &other) const {
   Conjunction out(other);
   out.tester = nullptr;
 
-  for (const ex &s : pars)
-    out.pars.append(s);
-
-  for (const ex &s : vars)
-    out.vars.append(s);
+  out.pars |= pars;
+  out.vars |= vars;
 
   out.removeJoin({}, eqs);
   out.removeJoin({}, ineqs);
@@ -485,11 +444,28 @@ bool Conjunction::removeJoin(const Constraints &toRemove,
     *this = obvious;
 
   removeUnused();
-  if (changed) {
-    clearTester();
+  // The tester is discarded by getTester, as a pass might still be using it
+  return changed;
+}
+
+bool Conjunction::joinGrowingTester(cc c) {
+  const bool current = (tester != nullptr) and (testerEqs == eqs) and
+                       (testerIneqs == ineqs);
+  const ConstraintSet prevEqs = eqs, prevIneqs = ineqs;
+  if (not removeJoin({}, {c}))
+    return false;
+  if ((not current) or (*this == absurd) or (*this == obvious))
     return true;
-  }
-  return false;
+  ConstraintSet expected = c->eq ? prevEqs : prevIneqs;
+  expected.insert(c);
+  if ((c->eq ? eqs : ineqs) != expected)
+    return true;
+  tester->addSource(c->exp);
+  if (c->eq)
+    tester->addSource(-c->exp);
+  testerEqs = eqs;
+  testerIneqs = ineqs;
+  return true;
 }
 
 bool Conjunction::hasInverseConstraints() const {
@@ -499,10 +475,7 @@ bool Conjunction::hasInverseConstraints() const {
   if (*this == obvious)
     return false;
 
-  for (cc c : ineqs)
-    if ((c->id < 0) and (ineqs.find(c->getNot()) != ineqs.end()))
-      return true;
-  return false;
+  return ineqs.hasComplementary();
 }
 
 bool Conjunction::empty() const { return (eqs.empty() and ineqs.empty()); }
@@ -3,9 +3,12 @@
 #define _CONJUNCTION_HPP_
 
 #include "Constraint.hpp"
+#include "ConstraintSet.hpp"
 #include "Schweighofer.hpp"
+#include "Stats.hpp"
 
 #include <iostream>
+#include <memory>
 #include <set>
 
 #ifndef NL
@@ -16,16 +19,12 @@ public:
   static Conjunction obvious, absurd;
 
   Symbols vars, pars;
-  Constraints eqs, ineqs;
-  SchweighoferTester *tester = nullptr;
+  ConstraintSet eqs, ineqs;
+  std::shared_ptr<SchweighoferTester> tester;
 
   Conjunction();
-  void clearTester() {
-    if (tester != nullptr) {
-      delete tester;
-      tester = nullptr;
-    }
-  }
+  // A Simplifier pass holding the tester keeps it alive
+  void clearTester() { tester.reset(); }
 
   ~Conjunction() {
     clearTester();
@@ -35,26 +34,55 @@ public:
     ineqs.clear();
   }
 
-  SchweighoferTester *getTester() {
-    if (tester == nullptr) {
-      exset sys;
-      if (Conjunction::absurd == *this)
-        sys.insert(-1);
-      else if (!(Conjunction::obvious == *this)) {
-        for (cc c : ineqs)
-          sys.insert(c->exp);
-        for (cc c : eqs) {
-          sys.insert(c->exp);
-          sys.insert(-c->exp);
-        }
+  /* The tester is built on the first request and kept while eqs and ineqs
+   * are the ones it was built from. Copies start without one, but takeTester
+   * hands it over between conjunctions holding the same system. */
+  SchweighoferTester *getTester() { return shareTester().get(); }
+  std::shared_ptr<SchweighoferTester> shareTester() {
+    if ((tester != nullptr) and
+        ((testerEqs != eqs) or (testerIneqs != ineqs))) {
+      DEBUG(6, "The constraints changed, discarding the tester\n");
+      clearTester();
+    }
+    if (tester != nullptr) {
+      stats::add("tester.reuses");
+      return tester;
+    }
+    exset sys;
+    if (Conjunction::absurd == *this)
+      sys.insert(-1);
+    else if (!(Conjunction::obvious == *this)) {
+      for (cc c : ineqs)
+        sys.insert(c->exp);
+      for (cc c : eqs) {
+        sys.insert(c->exp);
+        sys.insert(-c->exp);
       }
-      tester = new SchweighoferTester(sys);
     }
+    DEBUGIF(6, "Tester received this set of constraints:\n") {
+      int i = 1;
+      for (const ex &e : sys)
+        cerr << i++ << "  " << e << NL;
+    }
+    tester = std::make_shared<SchweighoferTester>(sys);
+    testerEqs = eqs;
+    testerIneqs = ineqs;
     return tester;
   }
+  // Take the tester of other, if it was built for our constraints
+  void takeTester(Conjunction &other) {
+    if ((other.tester == nullptr) or (other.testerEqs != other.eqs) or
+        (other.testerIneqs != other.ineqs) or (other.eqs != eqs) or
+        (other.ineqs != ineqs))
+      return;
+    clearTester();
+    swap(tester, other.tester);
+    testerEqs = eqs;
+    testerIneqs = ineqs;
+  }
   static Conjunction Make(bool val);
-  Conjunction(const Symbols &v, const Symbols &p, const Constraints &e,
-              const Constraints &i, const unsigned id);
+  Conjunction(const Symbols &v, const Symbols &p, const ConstraintSet &e,
+              const ConstraintSet &i, const unsigned id);
   Conjunction(const Symbols &v, const Symbols &p, const Constraints &c,
               const unsigned id);
   Conjunction(std::string &in);
@@ -78,10 +106,16 @@ public:
   //    bool removeEqs(bool userPars = false);
   void removeUnused();
   void removeUnused(Symbols &toSimplify);
+  // The symbols occurring in the constraints
+  Symbols usedSymbols() const;
   //    void removeRedundancy(const unsigned maxOr = 0, const unsigned maxSrcs =
   //    0); Conjunction simplify(const unsigned maxOr = 0, const unsigned
   //    maxSrcs = 0) const;
   bool operator==(const Conjunction &other) const;
+  /* Structural hash of vars, pars, eqs and ineqs. The constraint sets keep
+   * theirs up to date on every change; the symbol lists, a few words each,
+   * are hashed on every call. */
+  uint64_t hash() const;
   bool hasVariables() const;
 
   unsigned size() const { return 2 * eqs.size() + ineqs.size(); }
@@ -90,6 +124,9 @@ public:
   Conjunction operator&(const cc c) const;
   Conjunction operator&(const Constraints &clauses) const;
   bool removeJoin(const Constraints &toRemove, const Constraints &toJoin);
+  /* Join c, and if the tester is the one of the system before the join, add
+   * c to it instead of letting getTester discard it */
+  bool joinGrowingTester(cc c);
   void operator=(const Conjunction &other) {
     vars = other.vars;
     pars = other.pars;
@@ -157,6 +194,7 @@ public:
   int varsDegree(const ex &e) const { return polynomialDegree(e, false); }
 
 protected:
+  ConstraintSet testerEqs, testerIneqs; // The system the tester was built from
   void makeFalse();
   void variablesStr2set(std::string &str, Symbols &s);
   static unsigned counter;
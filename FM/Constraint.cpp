@@ -12,20 +12,29 @@ using namespace std;
 using namespace GiNaC;
 
 Constraint::cc Constraint::get(const int id) {
-  if (id == trueC.id)
-    return &trueC;
-  if (id == falseC.id)
-    return &falseC;
+  if (id == getTrue()->id)
+    return getTrue();
+  if (id == getFalse()->id)
+    return getFalse();
   return &(constraints.find(id)->second);
 }
 
+Constraint::cc Constraint::fromIndex(size_t idx) {
+  if (idx == getTrue()->index())
+    return getTrue();
+  if (idx == getFalse()->index())
+    return getFalse();
+  assert(idx < byIndex.size() and byIndex[idx] != nullptr);
+  return byIndex[idx];
+}
+
 Constraint::cc Constraint::get(const ex &expr, bool isEq) {
   if (obvious(expr, isEq)) {
-    return &trueC;
+    return getTrue();
   }
 
   if (absurd(expr, isEq)) {
-    return &falseC;
+    return getFalse();
   }
 
   ex x = expand(expr);
@@ -45,15 +54,15 @@ Constraint::cc Constraint::get(const ex &expr, bool isEq) {
 
   if (is_a<numeric>(exp)) {
     if (ex_to<numeric>(exp).is_negative())
-      return (&falseC);
+      return getFalse();
 
     if (not isEq)
-      return &trueC;
+      return getTrue();
 
     if (ex_to<numeric>(exp).is_zero())
-      return &trueC;
+      return getTrue();
 
-    return &falseC;
+    return getFalse();
   }
 
   for (auto const &ct : constraints) {
@@ -66,11 +75,15 @@ Constraint::cc Constraint::get(const ex &expr, bool isEq) {
 
   int id = nId++;
   DEBUG(10, id << "\n" << exp << "\n");
+  byIndex.resize(2 * id + 2, nullptr);
   // Always create the negation
   if (not isEq) {
-    constraints.insert({-id, {-exp - 1, -id, false}});
+    cc n = &constraints.insert({-id, {-exp - 1, -id, false}}).first->second;
+    byIndex[n->index()] = n;
   }
-  return &constraints.insert({id, {exp, id, isEq}}).first->second;
+  cc c = &constraints.insert({id, {exp, id, isEq}}).first->second;
+  byIndex[c->index()] = c;
+  return c;
 }
 
 Constraint::cc Constraint::get(std::string buf) {
@@ -78,10 +91,10 @@ Constraint::cc Constraint::get(std::string buf) {
   parser prsr(SymTab);
   ex x;
   if (buf.empty() or isTrue(buf))
-    return &Constraint::trueC;
+    return getTrue();
 
   if (isFalse(buf))
-    return &Constraint::falseC;
+    return getFalse();
 
   if (buf.substr(0, 2) == "eq") {
     op = SIGN::ZERO;
@@ -198,7 +211,7 @@ bool Constraint::absurd(const ex &exp, bool eq) {
 }
 
 Constraint::Constraint(const ex &d, const int oid, const bool e)
-    : exp(d), eq(e), id(oid) {}
+    : exp(d), symbs(Symbols::of(d)), eq(e), id(oid) {}
 
 Constraint::Constraint(bool t)
     : exp((t) ? 0 : -1), eq(false), id((t) ? 1 : -1) {}
@@ -229,10 +242,10 @@ bool Constraint::isFalse(const std::string &s) {
 }
 
 ostream &Constraint::print(ostream &out) const {
-  if (id == trueC.id)
+  if (id == getTrue()->id)
     return out << "true";
 
-  if (id == falseC.id)
+  if (id == getFalse()->id)
     return out << "false";
 
   static std::streambuf const *cerrbuf = std::cerr.rdbuf();
@@ -315,12 +328,12 @@ ostream &Constraint::c_print_recurse(ostream &out, ex op) const {
 }
 
 ostream &Constraint::c_print(ostream &out) const {
-  if (id == trueC.id) {
+  if (id == getTrue()->id) {
     DEBUG(10, exp << " --- becomes ---->" << 1 << NL);
     return out << 1;
   }
 
-  if (id == falseC.id) {
+  if (id == getFalse()->id) {
     DEBUG(10, exp << " --- becomes ---->" << 0 << NL);
     return out << 0;
   }
@@ -400,16 +413,15 @@ ostream &Constraint::c_print(ostream &out) const {
   DEBUG(10, exp << " --- becomes ---->" << lhsExp << " <= " << rhsExp << NL);
 
   stringstream lhsS, rhsS;
-  c_print_recurse(lhsS, factor(lhsExp));
-  c_print_recurse(rhsS, factor(rhsExp));
+  c_print_recurse(lhsS, factor_memo(lhsExp));
+  c_print_recurse(rhsS, factor_memo(rhsExp));
   DEBUG(10, exp << " ------------- becomes ---->" << lhsS.str() << oper1 << "="
                 << rhsS.str() << NL);
   return out << lhsS.str() << oper1 << "=" << rhsS.str();
 }
 
 map<int, Constraint> Constraint::constraints;
+vector<Constraint::cc> Constraint::byIndex;
 symtab Constraint::SymTab;
 lst Constraint::symbols;
-const Constraint Constraint::trueC(true);
-const Constraint Constraint::falseC(false);
 int Constraint::nId = 2;
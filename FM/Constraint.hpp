@@ -1,24 +1,36 @@
 #pragma once
 #ifndef __CONSTRAINT_HPP_
 #define __CONSTRAINT_HPP_
+#include "FlatSet.hpp"
+#include "Symbols.hpp"
 #include "debug.hpp"
 #include <ginac/ginac.h>
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <vector>
 
 const int BAD_INPUT = 1;
 
 class Constraint {
 public:
   const GiNaC::ex exp;
+  const Symbols symbs; // The symbols occurring in exp
   bool eq;
   typedef const Constraint *cc;
   typedef const GiNaC::ex cs;
 
   static cc get(const int id);
-  static cc getFalse() { return &falseC; }
-  static cc getTrue() { return &trueC; }
+  /* Built on the first call, so the static Conjunctions of other files can
+   * hold them whatever the order the files are initialized in. */
+  static cc getFalse() {
+    static const Constraint falseC(false);
+    return &falseC;
+  }
+  static cc getTrue() {
+    static const Constraint trueC(true);
+    return &trueC;
+  }
   static cs getOrInsertSymbol(const std::string &s) {
     if (s.length() == 0)
       return GiNaC::ex(0);
@@ -36,13 +48,17 @@ public:
   static cc get(const GiNaC::ex &expr, bool isEq = false);
   static void addSymbol(const std::string &s);
 
-  const static Constraint trueC, falseC;
-
   std::ostream &print(std::ostream &out) const;
   std::ostream &c_print(std::ostream &out) const;
 
   const Constraint *getNot() const { return get(-id); }
 
+  /* Dense index of the constraint, used by bitsets: 2 * id for positive ids
+   * and 2 * -id + 1 for their negations, so c and c->getNot() are neighbour
+   * bits of the same word. */
+  size_t index() const { return id > 0 ? 2 * id : 2 * -id + 1; }
+  static cc fromIndex(size_t idx);
+
   bool hasAny(const GiNaC::lst &list) const {
     for (const GiNaC::ex &e : list) {
       if (GiNaC::quo(exp, e, e).is_zero())
@@ -59,6 +75,7 @@ public:
 private:
   static int nId;
   static std::map<int, Constraint> constraints;
+  static std::vector<cc> byIndex;
   static bool obvious(const GiNaC::ex &exp, bool eq);
   static bool absurd(const GiNaC::ex &exp, bool eq);
 
@@ -74,8 +91,7 @@ template <class T> T &operator<<(T &out, Constraint::cc c) {
   return c->print(out);
 }
 
-typedef GiNaC::lst Symbols;
 typedef const Constraint *cc;
-typedef std::set<cc> Constraints;
+typedef FlatSet<cc> Constraints;
 
 #endif //__CONSTRAINT_HPP_
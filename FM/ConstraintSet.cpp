@@ -0,0 +1,319 @@
+#include "ConstraintSet.hpp"
+#include <algorithm>
+
+using namespace std;
+
+/* A node covers 32^height words. Only its non-empty slots are stored, in slot
+ * order: kids for the inner nodes, words at height 1. */
+struct ConstraintSet::Node {
+  uint32_t bitmap = 0;
+  vector<NodePtr> kids;
+  vector<uint64_t> words;
+};
+
+typedef ConstraintSet::Node Node;
+typedef ConstraintSet::NodePtr NodePtr;
+
+namespace {
+enum Op { AND, OR, ANDNOT };
+
+unsigned slot(uint64_t b, unsigned h) { return (b >> (5 * (h - 1))) & 31; }
+
+unsigned slotRank(uint32_t bitmap, unsigned s) {
+  return __builtin_popcount(bitmap & ((uint32_t(1) << s) - 1));
+}
+
+bool has(const Node *n, unsigned s) { return (n->bitmap >> s) & 1; }
+
+// The path copy of n with the word of block b set to w, nullptr if empty
+NodePtr withWord(const Node *n, unsigned h, uint64_t b, uint64_t w) {
+  shared_ptr<Node> r = n ? make_shared<Node>(*n) : make_shared<Node>();
+  const unsigned s = slot(b, h), k = slotRank(r->bitmap, s);
+  const bool present = has(r.get(), s);
+  if (h == 1) {
+    if (w and present)
+      r->words[k] = w;
+    else if (w)
+      r->words.insert(r->words.begin() + k, w);
+    else if (present)
+      r->words.erase(r->words.begin() + k);
+    r->bitmap = w ? (r->bitmap | (1u << s)) : (r->bitmap & ~(1u << s));
+  } else {
+    NodePtr c = withWord(present ? r->kids[k].get() : nullptr, h - 1, b, w);
+    if (c and present)
+      r->kids[k] = c;
+    else if (c)
+      r->kids.insert(r->kids.begin() + k, c);
+    else if (present)
+      r->kids.erase(r->kids.begin() + k);
+    r->bitmap = c ? (r->bitmap | (1u << s)) : (r->bitmap & ~(1u << s));
+  }
+  return r->bitmap ? NodePtr(r) : nullptr;
+}
+
+// First non-zero word at a block >= from, in the subtree covering from base
+bool firstWord(const Node *n, unsigned h, uint64_t base, uint64_t from,
+               uint64_t &b, uint64_t &w) {
+  const uint64_t span = uint64_t(1) << (5 * (h - 1));
+  for (uint64_t s = from > base ? (from - base) / span : 0; s < 32; s++) {
+    if (not has(n, s))
+      continue;
+    const unsigned k = slotRank(n->bitmap, s);
+    if (h == 1) {
+      b = base + s;
+      w = n->words[k];
+      return true;
+    }
+    if (firstWord(n->kids[k].get(), h - 1, base + s * span, from, b, w))
+      return true;
+  }
+  return false;
+}
+
+template <typename F>
+void forWords(const Node *n, unsigned h, uint64_t base, const F &f) {
+  if (n == nullptr)
+    return;
+  const uint64_t span = uint64_t(1) << (5 * (h - 1));
+  for (unsigned s = 0, k = 0; s < 32; s++) {
+    if (not has(n, s))
+      continue;
+    if (h == 1)
+      f(base + s, n->words[k]);
+    else
+      forWords(n->kids[k].get(), h - 1, base + s * span, f);
+    k++;
+  }
+}
+
+NodePtr lift(NodePtr n, unsigned from, unsigned to) {
+  for (; n and (from < to); from++) {
+    shared_ptr<Node> r = make_shared<Node>();
+    r->bitmap = 1;
+    r->kids.push_back(n);
+    n = r;
+  }
+  return n;
+}
+
+NodePtr combine(const NodePtr &a, const NodePtr &b, unsigned h, Op op) {
+  // Shared, or missing, subtrees are decided without looking into them
+  switch (op) {
+  case AND:
+    if ((not a) or (not b))
+      return nullptr;
+    if (a == b)
+      return a;
+    break;
+  case OR:
+    if ((not a) or (a == b))
+      return b;
+    if (not b)
+      return a;
+    break;
+  case ANDNOT:
+    if ((not a) or (a == b))
+      return nullptr;
+    if (not b)
+      return a;
+    break;
+  }
+  const uint32_t slots = op == OR ? (a->bitmap | b->bitmap)
+                                  : (op == AND ? (a->bitmap & b->bitmap)
+                                               : a->bitmap);
+  shared_ptr<Node> r = make_shared<Node>();
+  for (unsigned s = 0; s < 32; s++) {
+    if (not((slots >> s) & 1))
+      continue;
+    const bool inA = has(a.get(), s), inB = has(b.get(), s);
+    const unsigned kA = slotRank(a->bitmap, s), kB = slotRank(b->bitmap, s);
+    if (h == 1) {
+      const uint64_t wA = inA ? a->words[kA] : 0, wB = inB ? b->words[kB] : 0;
+      const uint64_t w =
+          op == AND ? (wA & wB) : (op == OR ? (wA | wB) : (wA & ~wB));
+      if (w) {
+        r->words.push_back(w);
+        r->bitmap |= 1u << s;
+      }
+    } else {
+      NodePtr c = combine(inA ? a->kids[kA] : nullptr,
+                          inB ? b->kids[kB] : nullptr, h - 1, op);
+      if (c) {
+        r->kids.push_back(c);
+        r->bitmap |= 1u << s;
+      }
+    }
+  }
+  return r->bitmap ? NodePtr(r) : nullptr;
+}
+
+bool equal(const Node *a, const Node *b, unsigned h) {
+  if (a == b)
+    return true;
+  if ((not a) or (not b) or (a->bitmap != b->bitmap))
+    return false;
+  if (h == 1)
+    return a->words == b->words;
+  for (size_t k = 0; k < a->kids.size(); k++)
+    if (not equal(a->kids[k].get(), b->kids[k].get(), h - 1))
+      return false;
+  return true;
+}
+
+// b is a subset of a
+bool subset(const Node *a, const Node *b, unsigned h) {
+  if ((a == b) or (not b))
+    return true;
+  if ((not a) or (b->bitmap & ~a->bitmap))
+    return false;
+  for (unsigned s = 0, kB = 0; s < 32; s++) {
+    if (not has(b, s))
+      continue;
+    const unsigned kA = slotRank(a->bitmap, s);
+    if (h == 1) {
+      if (b->words[kB] & ~a->words[kA])
+        return false;
+    } else if (not subset(a->kids[kA].get(), b->kids[kB].get(), h - 1))
+      return false;
+    kB++;
+  }
+  return true;
+}
+} // namespace
+
+uint64_t ConstraintSet::getWord(uint32_t b) const {
+  if ((root == nullptr) or ((uint64_t(b) >> (5 * height)) != 0))
+    return 0;
+  const Node *n = root.get();
+  for (unsigned lvl = height; lvl > 1; lvl--) {
+    const unsigned s = slot(b, lvl);
+    if (not has(n, s))
+      return 0;
+    n = n->kids[slotRank(n->bitmap, s)].get();
+  }
+  const unsigned s = slot(b, 1);
+  return has(n, s) ? n->words[slotRank(n->bitmap, s)] : 0;
+}
+
+void ConstraintSet::setWord(uint32_t b, uint64_t w) {
+  while ((uint64_t(b) >> (5 * height)) != 0) {
+    root = lift(root, height, height + 1);
+    height++;
+  }
+  root = withWord(root.get(), height, b, w);
+  shrink();
+}
+
+// Keep the smallest height holding all the words, so equal sets have equal
+// tries
+void ConstraintSet::shrink() {
+  while (root and (height > 1) and (root->bitmap == 1)) {
+    root = root->kids[0];
+    height--;
+  }
+  if (not root)
+    height = 1;
+}
+
+void ConstraintSet::recount() {
+  n = 0;
+  h = 0;
+  forWords(root.get(), height, 0, [this](uint64_t b, uint64_t w) {
+    n += __builtin_popcountll(w);
+    for (; w; w &= w - 1)
+      h ^= mix(b * 64 + __builtin_ctzll(w));
+  });
+}
+
+size_t ConstraintSet::next(size_t from) const {
+  if ((from == NONE) or (root == nullptr))
+    return NONE;
+  uint64_t b, w;
+  if (not firstWord(root.get(), height, 0, from / 64, b, w))
+    return NONE;
+  if (b == from / 64) {
+    w &= ~uint64_t(0) << (from % 64);
+    if ((w == 0) and (not firstWord(root.get(), height, 0, b + 1, b, w)))
+      return NONE;
+  }
+  return b * 64 + __builtin_ctzll(w);
+}
+
+size_t ConstraintSet::count(cc c) const {
+  const size_t i = c->index();
+  return (getWord(i / 64) >> (i % 64)) & 1;
+}
+
+pair<ConstraintSet::const_iterator, bool> ConstraintSet::insert(cc c) {
+  const size_t i = c->index();
+  const uint64_t bit = uint64_t(1) << (i % 64), w = getWord(i / 64);
+  if (w & bit)
+    return {const_iterator(this, i), false};
+  setWord(i / 64, w | bit);
+  n++;
+  h ^= mix(i);
+  return {const_iterator(this, i), true};
+}
+
+size_t ConstraintSet::erase(cc c) {
+  const size_t i = c->index();
+  const uint64_t bit = uint64_t(1) << (i % 64), w = getWord(i / 64);
+  if (not(w & bit))
+    return 0;
+  setWord(i / 64, w & ~bit);
+  n--;
+  h ^= mix(i);
+  return 1;
+}
+
+static ConstraintSet::NodePtr apply(const ConstraintSet::NodePtr &a,
+                                    unsigned hA,
+                                    const ConstraintSet::NodePtr &b,
+                                    unsigned hB, unsigned &h, Op op) {
+  h = max(hA, hB);
+  return combine(lift(a, hA, h), lift(b, hB, h), h, op);
+}
+
+ConstraintSet ConstraintSet::operator&(const ConstraintSet &o) const {
+  ConstraintSet r;
+  r.root = apply(root, height, o.root, o.height, r.height, AND);
+  r.shrink();
+  r.recount();
+  return r;
+}
+
+ConstraintSet ConstraintSet::operator|(const ConstraintSet &o) const {
+  ConstraintSet r;
+  r.root = apply(root, height, o.root, o.height, r.height, OR);
+  r.shrink();
+  r.recount();
+  return r;
+}
+
+ConstraintSet ConstraintSet::operator-(const ConstraintSet &o) const {
+  ConstraintSet r;
+  r.root = apply(root, height, o.root, o.height, r.height, ANDNOT);
+  r.shrink();
+  r.recount();
+  return r;
+}
+
+bool ConstraintSet::operator==(const ConstraintSet &o) const {
+  return (h == o.h) and (n == o.n) and (height == o.height) and
+         equal(root.get(), o.root.get(), height);
+}
+
+bool ConstraintSet::includes(const ConstraintSet &o) const {
+  if ((o.n > n) or (o.height > height))
+    return false;
+  return subset(root.get(), lift(o.root, o.height, height).get(), height);
+}
+
+bool ConstraintSet::hasComplementary() const {
+  // c at bit 2k and c->getNot() at bit 2k + 1
+  bool found = false;
+  forWords(root.get(), height, 0, [&found](uint64_t, uint64_t w) {
+    found |= (w & (w >> 1) & 0x5555555555555555ULL) != 0;
+  });
+  return found;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef _CONSTRAINTSET_HPP_
+#define _CONSTRAINTSET_HPP_
+
+#include "Constraint.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* Set of constraints stored as a sparse bitset over Constraint::index(). The
+ * non-zero 64 bits words live in a persistent hash array mapped trie, keyed
+ * by the word position, 5 bits per level. Nodes are never modified once
+ * shared: inserting or erasing copies the O(log n) nodes on the path to the
+ * word, so copying a set is O(1) and a branch of the Simplifier only pays for
+ * the constraints it changes. The set operations and comparisons work a word
+ * at a time, and skip the subtrees both sides share.
+ *
+ * It offers the part of the std::set<cc> interface we use, and iterates in
+ * index order, that is, in the order the constraints were created. */
+class ConstraintSet {
+public:
+  /* Iterators only keep the index of the current constraint, so they stay
+   * valid while other constraints are inserted or erased. */
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef cc value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const cc *pointer;
+    typedef cc reference;
+
+    const_iterator() {}
+    const_iterator(const ConstraintSet *s, size_t i) : set(s), idx(i) {}
+    cc operator*() const { return Constraint::fromIndex(idx); }
+    const_iterator &operator++() {
+      idx = set->next(idx + 1);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator r = *this;
+      ++*this;
+      return r;
+    }
+    bool operator==(const const_iterator &o) const { return idx == o.idx; }
+    bool operator!=(const const_iterator &o) const { return idx != o.idx; }
+
+  private:
+    friend class ConstraintSet;
+    const ConstraintSet *set = nullptr;
+    size_t idx = NONE;
+  };
+  typedef const_iterator iterator;
+  typedef cc value_type;
+
+  ConstraintSet() {}
+  ConstraintSet(const Constraints &s) { insert(s.begin(), s.end()); }
+  ConstraintSet(std::initializer_list<cc> l) { insert(l.begin(), l.end()); }
+  template <typename It> ConstraintSet(It first, It last) {
+    insert(first, last);
+  }
+
+  const_iterator begin() const { return const_iterator(this, next(0)); }
+  const_iterator end() const { return const_iterator(this, NONE); }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  void clear() { *this = ConstraintSet(); }
+
+  std::pair<const_iterator, bool> insert(cc c);
+  template <typename It> void insert(It first, It last) {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+  size_t erase(cc c);
+  const_iterator erase(const_iterator it) {
+    const_iterator r = it;
+    ++r;
+    erase(*it);
+    return r;
+  }
+  const_iterator find(cc c) const {
+    return count(c) ? const_iterator(this, c->index()) : end();
+  }
+  size_t count(cc c) const;
+
+  // Word at a time set algebra
+  ConstraintSet operator&(const ConstraintSet &o) const;
+  ConstraintSet operator|(const ConstraintSet &o) const;
+  ConstraintSet operator-(const ConstraintSet &o) const; // AND NOT
+  ConstraintSet &operator|=(const ConstraintSet &o) { return *this = *this | o; }
+  ConstraintSet &operator-=(const ConstraintSet &o) { return *this = *this - o; }
+  bool includes(const ConstraintSet &o) const; // o is a subset of this
+  // Holds some c and c->getNot()
+  bool hasComplementary() const;
+
+  /* Order independent hash of the elements, the XOR of a mix of their
+   * indexes, updated on every insert and erase. */
+  uint64_t hash() const { return h; }
+
+  bool operator==(const ConstraintSet &o) const;
+  bool operator!=(const ConstraintSet &o) const { return not(*this == o); }
+
+  operator Constraints() const { return Constraints(begin(), end()); }
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+private:
+  static const size_t NONE = SIZE_MAX;
+  // First index >= from holding a constraint, or NONE
+  size_t next(size_t from) const;
+  uint64_t getWord(uint32_t b) const;
+  void setWord(uint32_t b, uint64_t w);
+  void shrink();
+  void recount();
+
+  static uint64_t mix(uint64_t x) { // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  NodePtr root;        // nullptr when empty
+  unsigned height = 1; // The root covers 32^height words
+  size_t n = 0;
+  uint64_t h = 0;
+};
+
+#endif //_CONSTRAINTSET_HPP_
@@ -1,41 +1,306 @@
 #include "Disjunction.hpp"
+#include "Parallel.hpp"
 #include "Simplifier.hpp"
+#include "Stats.hpp"
 #include "debug.hpp"
+#include <algorithm>
 
 using namespace std;
 
+void Disjunction::reindex() {
+  index.clear();
+  for (iterator i = conjs.begin(); i != conjs.end(); i++)
+    index.insert({i->hash(), i});
+  indexed = true;
+}
+
+bool Disjunction::contains(const Conj &c) {
+  if (not indexed)
+    reindex();
+  auto range = index.equal_range(c.hash());
+  for (auto i = range.first; i != range.second; i++)
+    if (*i->second == c)
+      return true;
+  return false;
+}
+
+void Disjunction::append(const Conj &c, bool atFront) {
+  iterator i = atFront ? conjs.insert(conjs.begin(), c)
+                       : conjs.insert(conjs.end(), c);
+  if (indexed)
+    index.insert({c.hash(), i});
+  factored = false;
+}
+
 void Disjunction::join(const Conjs &cjs) {
-  for (const Conjunction &oc : cjs) {
-    bool insert = true;
-    for (const Conjunction &c : conjs) {
-      if (c == oc) {
-        insert = false;
-        break;
-      }
+  for (const Conjunction &oc : cjs)
+    if (not contains(oc))
+      append(oc);
+}
+
+void Disjunction::join(const Disjunction &other) { join(other.conjs); }
+
+namespace {
+/* Syntactic summary of a conjunction for the subsumption checks: its
+ * constraints, with the equalities also as their two inequalities, a Bloom
+ * mask of them, and its symbols. */
+struct Signature {
+  ConstraintSet closure;
+  Symbols symbs;
+  uint64_t mask = 0;
+  bool absurd, obvious;
+
+  Signature(const Conjunction &c)
+      : absurd(c == Conjunction::absurd), obvious(c == Conjunction::obvious) {
+    closure = c.ineqs;
+    for (cc eq : c.eqs) {
+      closure.insert(Constraint::get(eq->exp));
+      closure.insert(Constraint::get(-eq->exp));
     }
-    if (insert)
-      conjs.push_back(oc);
+    for (cc k : closure)
+      mask |= uint64_t(1) << (k->index() % 64);
+    symbs = c.vars | c.pars;
   }
+};
+
+typedef map<const Conjunction *, Signature> Signatures;
+
+const Signature &signature(Signatures &sigs, const Conjunction &c) {
+  auto it = sigs.find(&c);
+  if (it == sigs.end())
+    it = sigs.insert({&c, Signature(c)}).first;
+  return it->second;
 }
 
-void Disjunction::join(const Disjunction &other) { join(other.conjs); }
+enum Stage { TRIVIAL, SYNTACTIC, SYMBOLS, LP };
+
+/* Settles what a.implies(b) can without a tester: the obvious and absurd
+ * systems, b's constraints being a subset of a's, and b having symbols a does
+ * not have. Returns LP if a tester is needed. */
+Stage stage(const Signature &sa, const Signature &sb, bool &r) {
+  if (sb.absurd or sb.obvious or sa.absurd) {
+    r = sb.absurd ? sa.absurd : sb.obvious;
+    return TRIVIAL;
+  }
+  if ((0 == (sb.mask & ~sa.mask)) and sa.closure.includes(sb.closure)) {
+    r = true;
+    return SYNTACTIC;
+  }
+  if (not sa.symbs.includes(sb.symbs)) {
+    r = false;
+    return SYMBOLS;
+  }
+  return LP;
+}
+
+/* Outcome of the tester for the pair (a, b): '1' or '0' for a.implies(b),
+ * 'A' when the tester found a to be empty. */
+typedef map<pair<const Conjunction *, const Conjunction *>, char> LPResults;
+
+/* Same as a.implies(b), using stage first, then the results computed ahead
+ * by the workers, if any. */
+bool implies(Signatures &sigs, const LPResults &lp, Conjunction &a,
+             const Conjunction &b) {
+  static const char *const names[] = {
+      "implicators.trivial", "implicators.syntactic", "implicators.symbols",
+      "implicators.lp"};
+  stats::add("implicators.pairs");
+  bool r;
+  const Stage st = stage(signature(sigs, a), signature(sigs, b), r);
+  stats::add(names[st]);
+  if (st != LP)
+    return r;
+  auto known = lp.find({&a, &b});
+  if (known == lp.end())
+    r = a.implies(b);
+  else if (known->second == 'A') {
+    a = Conjunction::absurd;
+    r = false;
+  } else
+    r = known->second == '1';
+  if (a == Conjunction::absurd) // The tester found a to be empty
+    sigs.erase(&a);
+  return r;
+}
+
+/* Runs the tester on every pair of the disjunction stage can not settle,
+ * spread over the workers, one item per implying conjunction. The removals
+ * are then replayed in order, so the result does not depend on the number of
+ * jobs. Pairs the replay skips, as one of them was removed first, are wasted
+ * work. */
+LPResults testPairs(Signatures &sigs, list<Conjunction> &conjs) {
+  vector<pair<Conjunction *, vector<const Conjunction *>>> items;
+  for (Conjunction &a : conjs) {
+    vector<const Conjunction *> bs;
+    for (const Conjunction &b : conjs) {
+      bool r;
+      if ((&a != &b) and
+          (stage(signature(sigs, a), signature(sigs, b), r) == LP))
+        bs.push_back(&b);
+    }
+    if (not bs.empty())
+      items.push_back({&a, bs});
+  }
+  LPResults lp;
+  if (items.size() < 2)
+    return lp;
+  vector<string> res = parallel::map(items.size(), [&items](size_t i) {
+    Conjunction &a = *items[i].first;
+    const Conjunction orig = a;
+    string r;
+    for (const Conjunction *b : items[i].second) {
+      const bool imp = a.implies(*b);
+      if (a == Conjunction::absurd) {
+        r += 'A';
+        a = orig;
+      } else
+        r += imp ? '1' : '0';
+    }
+    return r;
+  });
+  for (size_t i = 0; i < items.size(); i++)
+    for (size_t k = 0; k < res[i].size(); k++)
+      lp[{items[i].first, items[i].second[k]}] = res[i][k];
+  return lp;
+}
+} // namespace
+
+namespace {
+// Constraint other than c != 0, whose negation we do not keep
+bool negable(cc c) { return not(c->eq and (c->index() & 1)); }
+
+/* Replaces a by the union of a and b, if it is a single conjunction. With S
+ * the constraints both hold:
+ *   S & c | S & !c is S,
+ *   S & e - 1 >= 0 | S & e == 0 is S & e >= 0,
+ *   S & c | S & Y is S if S & !c implies Y, which the tester decides. */
+bool coalesce(Conjunction &a, const Conjunction &b) {
+  if ((a == Conjunction::absurd) or (a == Conjunction::obvious) or
+      (b == Conjunction::absurd) or (b == Conjunction::obvious))
+    return false;
+  const ConstraintSet A = a.eqs | a.ineqs, B = b.eqs | b.ineqs;
+  const ConstraintSet S = A & B, onlyA = A - S, onlyB = B - S;
+  if (onlyA.empty() or onlyB.empty())
+    return false; // One implies the other, removeImplicators will see it
+  const ConstraintSet eqs = (a.eqs | b.eqs) & S;
+  ConstraintSet ineqs = (a.ineqs | b.ineqs) & S;
+  const Symbols vars = a.vars | b.vars, pars = a.pars | b.pars;
+
+  if ((onlyA.size() == 1) and (onlyB.size() == 1)) {
+    cc x = *onlyA.begin(), y = *onlyB.begin();
+    if ((not x->eq) and (x->getNot() == y)) {
+      stats::add("coalesce.complementary");
+      a = Conjunction(vars, pars, eqs, ineqs, a.id());
+      return true;
+    }
+    if (x->eq)
+      swap(x, y);
+    if ((not x->eq) and y->eq and negable(y) and
+        ((expand(x->exp + 1 - y->exp).is_zero()) or
+         (expand(x->exp + 1 + y->exp).is_zero()))) {
+      stats::add("coalesce.adjacent");
+      ineqs.insert(Constraint::get(x->exp + 1));
+      a = Conjunction(vars, pars, eqs, ineqs, a.id());
+      return true;
+    }
+  }
+
+  for (int side = 0; side < 2; side++) {
+    const ConstraintSet &only = side ? onlyB : onlyA;
+    const ConstraintSet &ys = side ? onlyA : onlyB;
+    if ((only.size() != 1) or (*only.begin())->eq)
+      continue;
+    bool usable = true;
+    for (cc y : ys)
+      usable &= negable(y);
+    if (not usable)
+      continue;
+    ConstraintSet notC = ineqs;
+    notC.insert((*only.begin())->getNot());
+    Conjunction t(vars, pars, eqs, notC, a.id());
+    stats::add("coalesce.tests");
+    if ((t == Conjunction::absurd) or t.implies(side ? a : b)) {
+      stats::add("coalesce.tester");
+      a = Conjunction(vars, pars, eqs, ineqs, a.id());
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+void Disjunction::coalesce() {
+  if (conjs.size() < 2)
+    return;
+  indexed = false;
+  factored = false;
+  const size_t before = conjs.size();
+  /* Pairs that did not merge, skipped until one of them changes, so a
+   * rescan only pays the tests, and the testers, of the merged element. The
+   * list nodes are never reallocated here, their addresses identify them. */
+  set<pair<const Conj *, const Conj *>> failed;
+  auto forget = [&failed](const Conj *c) {
+    for (auto f = failed.begin(); f != failed.end();)
+      if ((f->first == c) or (f->second == c))
+        f = failed.erase(f);
+      else
+        f++;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (iterator i1 = conjs.begin(); i1 != conjs.end(); i1++) {
+      for (iterator i2 = conjs.begin(); i2 != conjs.end();) {
+        if (i1 == i2) {
+          i2++;
+          continue;
+        }
+        if (failed.count({&*i1, &*i2})) {
+          stats::add("coalesce.cached");
+          i2++;
+          continue;
+        }
+        if (::coalesce(*i1, *i2)) {
+          DEBUG(4, "Coalesced into " << *i1 << NL);
+          forget(&*i1);
+          forget(&*i2);
+          conjs.erase(i2);
+          i2 = conjs.begin();
+          changed = true;
+        } else {
+          failed.insert({&*i1, &*i2});
+          i2++;
+        }
+      }
+    }
+  }
+  DEBUG(1, "Coalescing went from " << before << " to " << conjs.size()
+                                   << " disjuncts\n");
+  stats::add("coalesce.removed", before - conjs.size());
+}
 
 void Disjunction::removeImplicators() {
   if (conjs.size() < 2)
     return;
+  indexed = false;
+  factored = false;
 
+  Signatures sigs;
+  const LPResults lp =
+      parallel::jobs > 1 ? testPairs(sigs, conjs) : LPResults();
   iterator end = conjs.end();
   for (iterator i1 = conjs.begin(); i1 != end;) {
     for (iterator i2 = next(i1); i2 != end;) {
       DEBUG(4, "Testing if\n" << *i2 << "\nimplies\n" << *i1 << NL);
-      if (i2->implies(*i1)) {
+      if (implies(sigs, lp, *i2, *i1)) {
         DEBUG(4, "Yes it implies, removing the first one\n");
+        sigs.erase(&*i2);
         i2 = conjs.erase(i2);
         continue;
       }
       DEBUG(4, "Testing the other way\n");
-      if (i1->implies(*i2)) {
+      if (implies(sigs, lp, *i1, *i2)) {
         DEBUG(4, "Yes it implies, removing the second one\n");
+        sigs.erase(&*i1);
         i1 = conjs.erase(i1);
         i2 = next(i1);
         continue;
@@ -51,7 +316,7 @@ Disjunction::Disjunction() {}
 Disjunction::Disjunction(istream &in) {
   read(in);
   if (conjs.empty())
-    conjs.push_back(Conjunction::obvious);
+    append(Conjunction::obvious);
 }
 
 void Disjunction::read(istream &in) {
@@ -79,26 +344,135 @@ void Disjunction::read(istream &in) {
     DEBUG(10, "Build conjunction with: " << newConj << NL);
     if (newConj.size() > 3) {
       DEBUG(9, "Build new conjunction\n");
-      Conj nc(newConj);
-      for (const Conj &c : conjs)
-        if (nc == c)
-          continue;
-      conjs.push_back(nc);
+      read(newConj, false);
     }
   }
 
-  if (buff.size() > 3) {
-    Conj nc(buff);
-    for (const Conj &c : conjs)
-      if (nc == c)
-        continue;
-    conjs.push_front(nc);
+  if (buff.size() > 3)
+    read(buff, true);
+}
+
+namespace {
+// Split s at the sep characters out of parentheses
+vector<string> split(const string &s, char sep) {
+  vector<string> r(1);
+  int depth = 0;
+  for (char c : s) {
+    depth += (c == '(') - (c == ')');
+    if ((c == sep) and (depth == 0))
+      r.emplace_back();
+    else
+      r.back() += c;
+  }
+  return r;
+}
+
+// Is s a parenthesized group, and not a constraint starting with a (
+bool group(const string &s) {
+  if (s.empty() or (s.front() != '('))
+    return false;
+  int depth = 0;
+  for (size_t i = 0; i < s.size(); i++) {
+    depth += (s[i] == '(') - (s[i] == ')');
+    if (depth == 0)
+      return i + 1 == s.size();
+  }
+  return false;
+}
+
+/* The alternatives of a factored form, as written by Disjunction::print, each
+ * one as its constraints joined by & */
+vector<string> expand(const string &s) {
+  vector<string> r;
+  for (const string &alt : split(s, '|')) {
+    vector<string> prod(1);
+    for (const string &t : split(alt, '&')) {
+      const vector<string> sub =
+          group(t) ? expand(t.substr(1, t.size() - 2)) : vector<string>(1, t);
+      vector<string> next;
+      for (const string &p : prod)
+        for (const string &q : sub)
+          next.push_back(p.empty() ? q : (q.empty() ? p : p + '&' + q));
+      prod.swap(next);
+    }
+    r.insert(r.end(), prod.begin(), prod.end());
+  }
+  return r;
+}
+} // namespace
+
+void Disjunction::read(const string &in, bool atFront) {
+  const size_t s = in.find(':');
+  vector<string> alts(1, in);
+  if ((s != string::npos) and (in.find('|', s) != string::npos)) {
+    DEBUG(9, "Expanding the factored form " << in << NL);
+    alts = expand(in.substr(s + 1));
+    for (string &alt : alts)
+      alt = in.substr(0, s + 1) + alt;
+  }
+  for (string &alt : alts) {
+    Conj nc(alt);
+    if (not contains(nc))
+      append(nc, atFront);
   }
 }
 
-void Disjunction::simplifyFactor() { removeDuplicates(); }
+Disjunction::Factor Disjunction::factor(const vector<ConstraintSet> &sets) {
+  Factor f;
+  f.common = sets.front();
+  for (const ConstraintSet &s : sets)
+    f.common = f.common & s;
+  vector<ConstraintSet> rest;
+  for (const ConstraintSet &s : sets) {
+    rest.push_back(s - f.common);
+    if (rest.back().empty()) // This alternative is just common
+      return f;
+  }
+  // Group the alternatives holding the most frequent constraint, if it is
+  // shared by some, but not all of them
+  map<size_t, size_t> count;
+  for (const ConstraintSet &r : rest)
+    for (cc k : r)
+      count[k->index()]++;
+  size_t best = 0, most = 0;
+  for (const auto &c : count)
+    if (c.second > most) {
+      best = c.first;
+      most = c.second;
+    }
+  if ((most < 2) or (most == rest.size())) {
+    for (const ConstraintSet &r : rest)
+      f.alts.push_back({r, {}});
+    return f;
+  }
+  vector<ConstraintSet> with, without;
+  for (const ConstraintSet &r : rest)
+    (r.count(Constraint::fromIndex(best)) ? with : without).push_back(r);
+  f.alts.push_back(factor(with));
+  Factor others = factor(without);
+  if (others.common.empty())
+    f.alts.insert(f.alts.end(), others.alts.begin(), others.alts.end());
+  else
+    f.alts.push_back(others);
+  return f;
+}
+
+void Disjunction::simplifyFactor() {
+  removeDuplicates();
+  if ((conjs.size() < 2) or (conjs.front() == Conjunction::absurd))
+    return;
+  vector<ConstraintSet> sets;
+  for (const Conj &c : conjs)
+    sets.push_back(c.eqs | c.ineqs);
+  factors = factor(sets);
+  factored = true;
+  stats::add("factor.common", factors.common.size());
+}
 
 void Disjunction::removeDuplicates() {
+  index.clear();
+  indexed = false;
+  factored = false;
   for (iterator i = conjs.begin(); i != conjs.end();) {
     if (*i == Conjunction::obvious) {
       conjs.clear();
@@ -113,36 +487,101 @@ void Disjunction::removeDuplicates() {
         i++;
       continue;
     }
-    bool inc = true;
-    for (iterator ni = next(i); ni != conjs.end(); ni++) {
-      if (*i == *ni) {
-        iterator tmp = next(i);
-        conjs.erase(i);
-        i = tmp;
-        inc = false;
+    // Of the duplicates, keep the last one
+    const uint64_t h = i->hash();
+    auto range = index.equal_range(h);
+    for (auto d = range.first; d != range.second; d++) {
+      if (*d->second == *i) {
+        conjs.erase(d->second);
+        index.erase(d);
+        break;
       }
     }
-    if (inc)
-      i++;
+    index.insert({h, i});
+    i++;
   }
+  indexed = true;
 }
 
 void Disjunction::eliminateVariables() {
-  for (Conjs::iterator c = conjs.begin(); c != conjs.end();) {
-    if (c->hasVariables()) {
-      Conjunction nc = *c;
-      conjs.remove(*c);
-      DEBUG(4, "Removing variables from the conjunction: " << nc << NL);
-      Simplifier s(nc);
-      s.run();
-      conjs.splice(conjs.end(), s.get());
-      c = conjs.begin();
-    } else
-      c++;
+  indexed = false;
+  factored = false;
+  /* Systems with variables wait in pending, in order, and the results of the
+   * Simplifier go back to it or to done, each spliced in O(1). */
+  Conjs pending, done;
+  auto route = [&pending, &done](Conjs &from) {
+    while (not from.empty()) {
+      Conjs &to = from.front().hasVariables() ? pending : done;
+      to.splice(to.end(), from, from.begin());
+    }
+  };
+  route(conjs);
+  while (not pending.empty()) {
+    Conjunction nc = pending.front();
+    nc.takeTester(pending.front());
+    pending.pop_front();
+    DEBUG(4, "Removing variables from the conjunction: " << nc << NL);
+    Simplifier s(nc);
+    s.run();
+    Conjs res = s.get();
+    stats::add("simplifier.runs");
+    if (res.size() > 1)
+      stats::add("simplifier.branches", res.size() - 1);
+    route(res);
+  }
+  conjs.swap(done);
+}
+
+// common & ((alt1) | (alt2)), or with c, (common)&&(((alt1))||((alt2)))
+void Disjunction::print(ostream &out, const Factor &f, bool c) {
+  const char *const AND = c ? "&&" : " & ";
+  const char *const OR = c ? "||" : " | ";
+  string bef = "";
+  for (cc k : f.common) {
+    out << bef;
+    if (c)
+      k->c_print(out << '(') << ')';
+    else
+      out << k;
+    bef = AND;
   }
+  if (not f.alts.empty()) {
+    out << bef << '(';
+    bef = "";
+    for (const Factor &alt : f.alts) {
+      out << bef << '(';
+      print(out, alt, c);
+      out << ')';
+      bef = OR;
+    }
+    out << ')';
+  } else if (f.common.empty())
+    out << (c ? "1" : "true");
 }
 
 ostream &Disjunction::print(ostream &out) const {
+  if (factored) {
+    Symbols pars, vars;
+    for (const Conj &c : conjs) {
+      pars |= c.pars;
+      vars |= c.vars;
+    }
+    out << '[';
+    string before = "";
+    for (const ex &s : pars) {
+      out << before << s;
+      before = ",";
+    }
+    out << "]->[";
+    before = "";
+    for (const ex &s : vars) {
+      out << before << s;
+      before = ",";
+    }
+    out << "]: ";
+    print(out, factors, false);
+    return out << ';';
+  }
   string bef = "";
   for (const Conj &c : conjs) {
     out << bef << c;
@@ -152,18 +591,14 @@ ostream &Disjunction::print(ostream &out) const {
 }
 
 ostream &Disjunction::c_print(ostream &out) const {
-  Symbols symbs;
+  if (factored) {
+    out << "if ( ";
+    print(out, factors, true);
+    return out << " )";
+  }
   stringstream outs;
   string bef = "if ( (";
   for (const Conj &c : conjs) {
-    for (const ex &s : c.pars)
-      symbs.append(s);
-
-    for (const ex &s : c.vars)
-      symbs.append(s);
-
-    symbs.sort();
-    symbs.unique();
     outs << bef;
     c.c_print(outs);
     bef = ") || (";
@@ -2,6 +2,7 @@
 #ifndef _DISJUNCTION_HPP_
 #define _DISJUNCTION_HPP_
 #include "Conjunction.hpp"
+#include <unordered_map>
 using namespace std;
 
 typedef list<Conjunction> Conjs;
@@ -14,8 +15,22 @@ public:
   void join(const Conjs &cjs);
   void join(const Disjunction &other);
   void removeImplicators();
+  // Merge the disjuncts whose union is a single conjunction
+  void coalesce();
   Disjunction();
   Disjunction(istream &in);
+  // The index holds iterators into conjs, a copy rebuilds its own
+  Disjunction(const Disjunction &other)
+      : conjs(other.conjs), factors(other.factors),
+        factored(other.factored) {}
+  Disjunction &operator=(const Disjunction &other) {
+    conjs = other.conjs;
+    index.clear();
+    indexed = false;
+    factors = other.factors;
+    factored = other.factored;
+    return *this;
+  }
   void read(istream &in);
   void simplifyFactor();
 
@@ -32,7 +47,30 @@ public:
   ostream &c_print(ostream &out) const;
 
 private:
+  bool contains(const Conj &c);
+  void append(const Conj &c, bool atFront = false);
+  void reindex();
+  // Read one conjunction, or all those of a factored form
+  void read(const string &in, bool atFront);
+
+  /* Factored form of the disjunction, built by simplifyFactor: the
+   * constraints common to all the alternatives, and the alternatives, each
+   * factored again. */
+  struct Factor {
+    ConstraintSet common;
+    vector<Factor> alts;
+  };
+  static Factor factor(const vector<ConstraintSet> &sets);
+  static void print(ostream &out, const Factor &f, bool c);
+
   Conjs conjs;
+  /* Hash index of conjs, for the duplicate checks. Appending keeps it up to
+   * date, any other change of conjs must reset indexed. */
+  unordered_multimap<uint64_t, iterator> index;
+  bool indexed = false;
+  // Valid while factored is set, any change of conjs must reset it
+  Factor factors;
+  bool factored = false;
 };
 
 ostream &operator<<(ostream &out, const Disjunction &s);
@@ -0,0 +1,161 @@
+#pragma once
+#ifndef _FLATSET_HPP_
+#define _FLATSET_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/* Sorted set kept in a flat array: the first N elements live inside the
+ * object, so small sets never allocate, and larger ones use a single vector.
+ * It offers the std::set interface, with iterators being plain pointers that
+ * only stay valid until the set changes, and a range insert that sorts and
+ * merges the new elements at once. The set algebra merges the sorted arrays
+ * in linear time. */
+template <typename T, size_t N = 16, typename Less = std::less<T>>
+class FlatSet {
+public:
+  typedef T value_type;
+  typedef T key_type;
+  typedef const T *const_iterator;
+  typedef const_iterator iterator;
+  typedef size_t size_type;
+
+  FlatSet() {}
+  FlatSet(std::initializer_list<T> l) { insert(l.begin(), l.end()); }
+  template <typename It> FlatSet(It first, It last) { insert(first, last); }
+
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + n; }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  void clear() {
+    n = 0;
+    heap.clear();
+    onHeap = false;
+  }
+
+  const_iterator lower_bound(const T &x) const {
+    return std::lower_bound(begin(), end(), x, Less());
+  }
+  const_iterator find(const T &x) const {
+    const_iterator it = lower_bound(x);
+    return ((it != end()) and (not Less()(x, *it))) ? it : end();
+  }
+  size_t count(const T &x) const { return find(x) != end(); }
+
+  std::pair<const_iterator, bool> insert(const T &x) {
+    const size_t pos = lower_bound(x) - begin();
+    if ((pos < n) and (not Less()(x, data()[pos])))
+      return {begin() + pos, false};
+    if ((not onHeap) and (n == N)) {
+      heap.assign(inl, inl + n);
+      onHeap = true;
+    }
+    if (onHeap)
+      heap.insert(heap.begin() + pos, x);
+    else {
+      std::copy_backward(inl + pos, inl + n, inl + n + 1);
+      inl[pos] = x;
+    }
+    n++;
+    return {begin() + pos, true};
+  }
+  // Appends the range, then sorts and merges it with one pass
+  template <typename It> void insert(It first, It last) {
+    std::vector<T> add(first, last);
+    if (add.size() < 2) {
+      for (const T &x : add)
+        insert(x);
+      return;
+    }
+    std::sort(add.begin(), add.end(), Less());
+    add.erase(std::unique(add.begin(), add.end(), equal), add.end());
+    std::vector<T> merged;
+    merged.reserve(n + add.size());
+    std::set_union(begin(), end(), add.begin(), add.end(),
+                   std::back_inserter(merged), Less());
+    assign(merged);
+  }
+
+  size_t erase(const T &x) {
+    const_iterator it = find(x);
+    if (it == end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+  const_iterator erase(const_iterator it) {
+    const size_t pos = it - begin();
+    if (onHeap)
+      heap.erase(heap.begin() + pos);
+    else
+      std::copy(inl + pos + 1, inl + n, inl + pos);
+    n--;
+    return begin() + pos;
+  }
+
+  FlatSet operator|(const FlatSet &o) const {
+    return combine(o, [](const_iterator a, const_iterator aEnd,
+                         const_iterator b, const_iterator bEnd, T *out) {
+      return std::set_union(a, aEnd, b, bEnd, out, Less());
+    });
+  }
+  FlatSet operator&(const FlatSet &o) const {
+    return combine(o, [](const_iterator a, const_iterator aEnd,
+                         const_iterator b, const_iterator bEnd, T *out) {
+      return std::set_intersection(a, aEnd, b, bEnd, out, Less());
+    });
+  }
+  FlatSet operator-(const FlatSet &o) const {
+    return combine(o, [](const_iterator a, const_iterator aEnd,
+                         const_iterator b, const_iterator bEnd, T *out) {
+      return std::set_difference(a, aEnd, b, bEnd, out, Less());
+    });
+  }
+  FlatSet &operator|=(const FlatSet &o) { return *this = *this | o; }
+  FlatSet &operator-=(const FlatSet &o) { return *this = *this - o; }
+  bool includes(const FlatSet &o) const {
+    return std::includes(begin(), end(), o.begin(), o.end(), Less());
+  }
+
+  bool operator==(const FlatSet &o) const {
+    return (n == o.n) and std::equal(begin(), end(), o.begin(), equal);
+  }
+  bool operator!=(const FlatSet &o) const { return not(*this == o); }
+
+private:
+  static bool equal(const T &a, const T &b) {
+    return not(Less()(a, b) or Less()(b, a));
+  }
+  const T *data() const { return onHeap ? heap.data() : inl; }
+  void assign(const std::vector<T> &v) {
+    n = v.size();
+    onHeap = n > N;
+    if (onHeap)
+      heap = v;
+    else {
+      heap.clear();
+      std::copy(v.begin(), v.end(), inl);
+    }
+  }
+  template <typename F> FlatSet combine(const FlatSet &o, const F &f) const {
+    std::vector<T> out(n + o.n);
+    out.resize(f(begin(), end(), o.begin(), o.end(), out.data()) -
+               out.data());
+    FlatSet r;
+    r.assign(out);
+    return r;
+  }
+
+  T inl[N] = {};
+  std::vector<T> heap; // Holds the elements instead of inl, once past N
+  size_t n = 0;
+  bool onHeap = false;
+};
+
+#endif //_FLATSET_HPP_
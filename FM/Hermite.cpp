@@ -0,0 +1,200 @@
+#include "Hermite.hpp"
+#include "Stats.hpp"
+#include "debug.hpp"
+#include <cstdint>
+
+using namespace std;
+using namespace GiNaC;
+
+namespace hermite {
+
+// x = a * x - b * y, false if it overflows
+static bool combine(int64_t &x, int64_t a, int64_t b, int64_t y) {
+  int64_t ax, by;
+  if (__builtin_mul_overflow(a, x, &ax) or __builtin_mul_overflow(b, y, &by) or
+      __builtin_sub_overflow(ax, by, &x))
+    return false;
+  return x != INT64_MIN; // So that negating x never overflows
+}
+
+static bool combine(numeric &x, const numeric &a, const numeric &b,
+                    const numeric &y) {
+  x = a * x - b * y;
+  return true;
+}
+
+static bool isZero(int64_t x) { return x == 0; }
+static bool isZero(const numeric &x) { return x.is_zero(); }
+static bool isNegative(int64_t x) { return x < 0; }
+static bool isNegative(const numeric &x) { return x.is_negative(); }
+static int64_t magnitude(int64_t x) { return x < 0 ? -x : x; }
+static numeric magnitude(const numeric &x) { return abs(x); }
+static int64_t quotient(int64_t a, int64_t b) { return a / b; }
+static numeric quotient(const numeric &a, const numeric &b) {
+  return iquo(a, b);
+}
+static int64_t gcdOf(int64_t a, int64_t b) {
+  a = magnitude(a);
+  b = magnitude(b);
+  while (b) {
+    const int64_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+static numeric gcdOf(const numeric &a, const numeric &b) { return gcd(a, b); }
+static numeric toNumeric(int64_t x) { return numeric(long(x)); }
+static const numeric &toNumeric(const numeric &x) { return x; }
+static void fromNumeric(const numeric &n, int64_t &x) { x = n.to_long(); }
+static void fromNumeric(const numeric &n, numeric &x) { x = n; }
+
+// Row i = alpha * row i - beta * row j
+template <typename T>
+static bool rowOp(vector<vector<T>> &a, vector<ex> &r, size_t i,
+                  const T &alpha, const T &beta, size_t j) {
+  for (size_t k = 0; k < a[i].size(); k++)
+    if (not combine(a[i][k], alpha, beta, a[j][k]))
+      return false;
+  r[i] = expand(toNumeric(alpha) * r[i] - toNumeric(beta) * r[j]);
+  return true;
+}
+
+// Divide the row by the content it shares with its constant part
+template <typename T> static void normalize(vector<T> &row, ex &r) {
+  T g = 0;
+  for (const T &x : row)
+    g = gcdOf(g, x);
+  numeric gn = toNumeric(g);
+  if (not r.is_zero())
+    gn = gcd(gn, r.integer_content());
+  if (gn.is_zero() or (gn == 1))
+    return;
+  fromNumeric(gn, g);
+  for (T &x : row)
+    x = quotient(x, g);
+  r = expand(r / gn);
+}
+
+/* Echelon form of the rows a * vars + r, the pivot of row p being at column
+ * cols[p], reduced above the pivots. Returns false on overflow. */
+template <typename T>
+static bool echelon(vector<vector<T>> &a, vector<ex> &r, vector<size_t> &cols) {
+  const size_t m = a.size(), n = m ? a[0].size() : 0;
+  size_t top = 0;
+  for (size_t k = 0; (k < n) and (top < m); k++) {
+    bool found = false;
+    while (true) {
+      // Euclid over the column, the smallest coefficient reduces the others
+      size_t best = m;
+      for (size_t i = top; i < m; i++)
+        if ((not isZero(a[i][k])) and
+            ((best == m) or (magnitude(a[i][k]) < magnitude(a[best][k]))))
+          best = i;
+      if (best == m)
+        break;
+      found = true;
+      swap(a[top], a[best]);
+      swap(r[top], r[best]);
+      bool reduced = true;
+      for (size_t i = top + 1; i < m; i++) {
+        if (isZero(a[i][k]))
+          continue;
+        if (not rowOp(a, r, i, T(1), quotient(a[i][k], a[top][k]), top))
+          return false;
+        reduced &= isZero(a[i][k]);
+      }
+      if (reduced)
+        break;
+    }
+    if (not found)
+      continue;
+    if (isNegative(a[top][k]) and (not rowOp(a, r, top, T(-1), T(0), top)))
+      return false;
+    cols.push_back(k);
+    top++;
+  }
+  for (size_t p = cols.size(); p-- > 0;) {
+    const size_t k = cols[p];
+    normalize(a[p], r[p]);
+    for (size_t i = 0; i < p; i++) {
+      if (isZero(a[i][k]))
+        continue;
+      const T g = gcdOf(a[p][k], a[i][k]);
+      if (not rowOp(a, r, i, quotient(a[p][k], g), quotient(a[i][k], g), p))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool linear(const ex &e, const vector<ex> &vars, vector<numeric> &coeffs,
+            ex &cst) {
+  const ex x = expand(e);
+  coeffs.assign(vars.size(), 0);
+  cst = x;
+  for (size_t j = 0; j < vars.size(); j++) {
+    if ((x.degree(vars[j]) > 1) or (x.ldegree(vars[j]) < 0))
+      return false;
+    const ex c = x.coeff(vars[j], 1);
+    if ((not is_a<numeric>(c)) or (not ex_to<numeric>(c).is_integer()))
+      return false;
+    coeffs[j] = ex_to<numeric>(c);
+    cst -= c * vars[j];
+  }
+  cst = expand(cst);
+  for (const ex &v : vars)
+    if (cst.has(v))
+      return false;
+  return true;
+}
+
+bool reduce(const vector<ex> &eqs, const vector<ex> &vars,
+            vector<Pivot> &pivots, vector<ex> &rest) {
+  const size_t m = eqs.size();
+  vector<vector<numeric>> big(m);
+  vector<ex> csts(m);
+  for (size_t i = 0; i < m; i++)
+    if (not linear(eqs[i], vars, big[i], csts[i]))
+      return false;
+
+  const numeric limit = numeric(long(INT64_MAX));
+  bool fits = true;
+  vector<vector<int64_t>> small(m, vector<int64_t>(vars.size(), 0));
+  for (size_t i = 0; i < m; i++)
+    for (size_t j = 0; j < vars.size(); j++) {
+      if (abs(big[i][j]) > limit)
+        fits = false;
+      else
+        small[i][j] = big[i][j].to_long();
+    }
+  vector<size_t> cols;
+  vector<ex> r = csts;
+  if (fits and echelon(small, r, cols)) {
+    for (size_t i = 0; i < m; i++)
+      for (size_t j = 0; j < vars.size(); j++)
+        big[i][j] = toNumeric(small[i][j]);
+  } else {
+    DEBUG(4, "The reduction overflows int64_t, using CLN\n");
+    stats::add("hermite.overflows");
+    r = csts;
+    cols.clear();
+    echelon(big, r, cols);
+  }
+  if (cols.empty())
+    return false;
+
+  for (size_t p = 0; p < cols.size(); p++) {
+    ex rhs = -r[p];
+    for (size_t j = 0; j < vars.size(); j++)
+      if (j != cols[p])
+        rhs -= big[p][j] * vars[j];
+    pivots.push_back({vars[cols[p]], big[p][cols[p]], expand(rhs)});
+  }
+  for (size_t i = cols.size(); i < m; i++)
+    if (not r[i].is_zero())
+      rest.push_back(r[i]);
+  stats::add("hermite.eliminated", pivots.size());
+  return true;
+}
+} // namespace hermite
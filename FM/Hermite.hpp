@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _HERMITE_HPP_
+#define _HERMITE_HPP_
+
+#include <ginac/ginac.h>
+#include <vector>
+
+using namespace std;
+using namespace GiNaC;
+
+/* Integer elimination over a batch of linear equalities. The equalities
+ * e_i == 0 must be linear, with integer coefficients, in the eliminated
+ * symbols; any other symbol is kept in their constant part. They are put in
+ * an echelon form by unimodular row operations, choosing the smallest
+ * coefficient as pivot as in an Euclid gcd, and then reduced above the pivots
+ * by fraction free combinations. Every row operation keeps the integer
+ * solutions of the system, so the result is the same system.
+ *
+ * The coefficients are kept in int64_t, with every product and sum checked
+ * for overflow. If one overflows, the reduction is restarted in CLN numerics,
+ * that do not. */
+namespace hermite {
+// coeff * var == rhs, with coeff > 0 and rhs free of the other pivots
+struct Pivot {
+  ex var;
+  numeric coeff;
+  ex rhs;
+};
+
+// Returns true if e is linear in vars with integer coefficients
+bool linear(const ex &e, const vector<ex> &vars, vector<numeric> &coeffs,
+            ex &cst);
+/* Reduces the equalities eqs == 0, linear in vars. Gives one pivot per
+ * independent equality, and in rest the equalities left without any of vars.
+ * Returns false if there was nothing to eliminate. */
+bool reduce(const vector<ex> &eqs, const vector<ex> &vars,
+            vector<Pivot> &pivots, vector<ex> &rest);
+} // namespace hermite
+
+#endif //_HERMITE_HPP_
@@ -0,0 +1,116 @@
+#include "Parallel.hpp"
+#include "Stats.hpp"
+#include "debug.hpp"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace parallel {
+unsigned jobs = 1;
+
+static bool writeAll(int fd, const string &s) {
+  for (size_t done = 0; done < s.size();) {
+    ssize_t w = write(fd, s.data() + done, s.size() - done);
+    if (w <= 0)
+      return false;
+    done += w;
+  }
+  return true;
+}
+
+static void putString(string &buf, const string &s) {
+  const uint64_t sz = s.size();
+  buf.append(reinterpret_cast<const char *>(&sz), sizeof(sz));
+  buf += s;
+}
+
+static bool getString(const string &buf, size_t &pos, string &s) {
+  uint64_t sz;
+  if (buf.size() - pos < sizeof(sz))
+    return false;
+  buf.copy(reinterpret_cast<char *>(&sz), sizeof(sz), pos);
+  pos += sizeof(sz);
+  if (buf.size() - pos < sz)
+    return false;
+  s = buf.substr(pos, sz);
+  pos += sz;
+  return true;
+}
+
+/* Worker w computes the items w, w + jobs, w + 2 * jobs ..., and sends them,
+ * followed by the statistics counters it changed. */
+static void worker(int fd, size_t w, size_t nJobs, size_t items,
+                   const function<string(size_t)> &work) {
+  const auto before = stats::all();
+  string buf;
+  for (size_t i = w; i < items; i += nJobs)
+    putString(buf, work(i));
+  for (const auto &c : stats::all()) {
+    auto b = before.find(c.first);
+    const unsigned long long d =
+        c.second - (b == before.end() ? 0 : b->second);
+    if (d) {
+      putString(buf, c.first);
+      putString(buf, to_string(d));
+    }
+  }
+  _exit(writeAll(fd, buf) ? 0 : 1);
+}
+
+vector<string> map(size_t items, const function<string(size_t)> &work) {
+  vector<string> results(items);
+  vector<bool> done(items, false);
+  const size_t nJobs = min<size_t>(jobs, items);
+  if (nJobs > 1) {
+    cout.flush();
+    cerr.flush();
+    vector<pair<pid_t, int>> workers;
+    for (size_t w = 0; w < nJobs; w++) {
+      int fds[2];
+      if (pipe(fds) != 0)
+        break;
+      pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        worker(fds[1], w, nJobs, items, work);
+      }
+      close(fds[1]);
+      if (pid < 0) {
+        close(fds[0]);
+        break;
+      }
+      workers.push_back({pid, fds[0]});
+    }
+    // Workers block once their pipe is full, reading them in turn is enough
+    for (size_t w = 0; w < workers.size(); w++) {
+      string buf;
+      char chunk[1 << 16];
+      for (ssize_t r; (r = read(workers[w].second, chunk, sizeof(chunk))) > 0;)
+        buf.append(chunk, r);
+      close(workers[w].second);
+      int status;
+      waitpid(workers[w].first, &status, 0);
+      if (not(WIFEXITED(status) and (WEXITSTATUS(status) == 0))) {
+        DEBUG(1, "Worker " << w << " failed, redoing its items\n");
+        continue;
+      }
+      size_t pos = 0;
+      for (size_t i = w; i < items; i += nJobs) {
+        if (not getString(buf, pos, results[i]))
+          break;
+        done[i] = true;
+      }
+      for (string name, value;
+           getString(buf, pos, name) and getString(buf, pos, value);)
+        stats::add(name, stoull(value));
+    }
+    stats::add("parallel.workers", workers.size());
+  }
+  for (size_t i = 0; i < items; i++)
+    if (not done[i])
+      results[i] = work(i);
+  return results;
+}
+} // namespace parallel
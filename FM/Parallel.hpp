@@ -0,0 +1,24 @@
+#pragma once
+#ifndef _PARALLEL_HPP_
+#define _PARALLEL_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* GiNaC and our constraint tables are not thread safe, so work is spread over
+ * forked worker processes instead of threads. Each worker gets a copy of the
+ * whole state, computes its share of the items and sends back one string per
+ * item through a pipe, plus the statistics it gathered. Results are returned
+ * in item order, so callers merge them the same way for any number of jobs.
+ * With a single job, or if a worker fails, the items are computed in this
+ * process. */
+namespace parallel {
+extern unsigned jobs; // Set by -j, defaults to 1
+
+vector<string> map(size_t items, const function<string(size_t)> &work);
+} // namespace parallel
+
+#endif //_PARALLEL_HPP_
@@ -0,0 +1,145 @@
+#include "Planner.hpp"
+#include "Stats.hpp"
+#include "debug.hpp"
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace GiNaC;
+
+namespace planner {
+Strategy strategy = GREEDY;
+unsigned depth = 2;
+
+// Abstract systems growing beyond this are not combined any further
+static const size_t MAX_ROWS = 2000;
+
+bool parse(const string &name) {
+  if (name == "greedy")
+    strategy = GREEDY;
+  else if (name == "cost")
+    strategy = COST;
+  else if (name == "lookahead")
+    strategy = LOOKAHEAD;
+  else
+    return false;
+  return true;
+}
+
+// Sign of q over the box, by interval arithmetic if it is linear
+static char sign(const ex &q, const IntegerBox &box) {
+  if (is_a<numeric>(q))
+    return ex_to<numeric>(q).is_positive() ? '+' : '-';
+  gexmap<numeric> coeffs;
+  numeric lo, hi;
+  if (not IntegerBox::linear(expand(q), coeffs, lo))
+    return '?';
+  hi = lo;
+  bool hasLo = true, hasHi = true;
+  for (const auto &c : coeffs) {
+    const Interval I = box.get(c.first);
+    const bool pos = c.second.is_positive();
+    hasLo = hasLo and (pos ? I.hasLo : I.hasHi);
+    hasHi = hasHi and (pos ? I.hasHi : I.hasLo);
+    if (hasLo)
+      lo += c.second * (pos ? I.lo : I.hi);
+    if (hasHi)
+      hi += c.second * (pos ? I.hi : I.lo);
+  }
+  if (hasLo and lo.is_positive())
+    return '+';
+  if (hasHi and hi.is_negative())
+    return '-';
+  return '?';
+}
+
+Row row(const ex &ineq, const Symbols &vars, const IntegerBox &box) {
+  Row r;
+  for (const ex &v : vars) {
+    const ex q = expand(quo(ineq, v, v));
+    if (not q.is_zero())
+      r[v] = sign(q, box);
+  }
+  return r;
+}
+
+double cost(const vector<Row> &rows, const ex &v) {
+  double lb = 0, ub = 0, unknown = 0, fill = 0;
+  for (const Row &r : rows) {
+    auto it = r.find(v);
+    if (it == r.end())
+      continue;
+    (it->second == '+' ? lb : (it->second == '-' ? ub : unknown)) += 1;
+    fill = max(fill, double(r.size() - 1));
+  }
+  /* A constraint of unknown sign is a bound on both sides, and might split
+   * the system in two. The generated constraints hold the variables of both
+   * parents. */
+  const double pairs = (lb + unknown) * (ub + unknown);
+  return pairs * pow(2.0, min(unknown, 30.0)) * (1 + 2 * fill);
+}
+
+vector<Row> eliminate(const vector<Row> &rows, const ex &v) {
+  vector<Row> out, lbs, ubs;
+  for (const Row &r : rows) {
+    auto it = r.find(v);
+    if (it == r.end()) {
+      out.push_back(r);
+      continue;
+    }
+    const char s = it->second;
+    Row rest = r;
+    rest.erase(v);
+    if (s != '-')
+      lbs.push_back(rest);
+    if (s != '+')
+      ubs.push_back(rest);
+  }
+  for (const Row &l : lbs)
+    for (const Row &u : ubs) {
+      if (out.size() >= MAX_ROWS)
+        return out;
+      Row n = l;
+      for (const auto &w : u) {
+        auto it = n.find(w.first);
+        if (it == n.end())
+          n.insert(w);
+        else if (it->second != w.second)
+          it->second = '?';
+      }
+      out.push_back(n);
+    }
+  return out;
+}
+
+static double best(const vector<Row> &rows, const vector<ex> &vars,
+                   unsigned depth, ex *choice) {
+  double min = numeric_limits<double>::infinity();
+  for (size_t i = 0; i < vars.size(); i++) {
+    double c = cost(rows, vars[i]);
+    if (c >= min) // Costs are never negative
+      continue;
+    if ((depth > 1) and (vars.size() > 1)) {
+      vector<ex> others = vars;
+      others.erase(others.begin() + i);
+      c += best(eliminate(rows, vars[i]), others, depth - 1, nullptr);
+    }
+    if (c < min) {
+      min = c;
+      if (choice != nullptr)
+        *choice = vars[i];
+    }
+  }
+  return min;
+}
+
+ex select(const vector<Row> &rows, const vector<ex> &vars, unsigned depth) {
+  assert(not vars.empty());
+  ex choice = vars.front();
+  const double c = best(rows, vars, max(1u, depth), &choice);
+  DEBUG(3, "Planner selected " << choice << " with cost " << c << NL);
+  (void)c;
+  stats::add("planner.selections");
+  return choice;
+}
+} // namespace planner
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _PLANNER_HPP_
+#define _PLANNER_HPP_
+
+#include "Symbols.hpp"
+#include "Univariate.hpp"
+#include <vector>
+
+using namespace std;
+using namespace GiNaC;
+
+/* Order in which the Simplifier eliminates the variables. GREEDY is the
+ * historical choice of Simplifier::selectTarget, by degree, non numeric
+ * coefficients and occurrences. COST estimates, for each candidate, the
+ * Fourier-Motzkin combinations |lb| x |ub|, the sign splits of the
+ * coefficients whose sign the IntegerBox can't decide, and the size of the
+ * generated constraints; LOOKAHEAD adds the cost of the best eliminations
+ * that would follow, on an abstract model of the system. The weights of COST
+ * are estimates, not fitted on the inputs: GREEDY stays the default until
+ * make bench shows otherwise. */
+namespace planner {
+enum Strategy { GREEDY, COST, LOOKAHEAD };
+extern Strategy strategy; // Set by -p, GREEDY by default
+extern unsigned depth;    // Eliminations LOOKAHEAD looks at, 2 by default
+
+// Set strategy from its name, returns false if unknown
+bool parse(const string &name);
+
+/* Abstract constraint: the sign of the coefficient of each variable in it,
+ * '+', '-', or '?' if unknown. */
+typedef gexmap<char> Row;
+Row row(const ex &ineq, const Symbols &vars, const IntegerBox &box);
+// Estimated cost of eliminating v
+double cost(const vector<Row> &rows, const ex &v);
+// The rows after eliminating v
+vector<Row> eliminate(const vector<Row> &rows, const ex &v);
+// The cheapest variable to eliminate, looking ahead depth eliminations
+ex select(const vector<Row> &rows, const vector<ex> &vars, unsigned depth);
+} // namespace planner
+
+#endif //_PLANNER_HPP_
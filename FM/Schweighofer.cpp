@@ -1,4 +1,6 @@
 #include "Schweighofer.hpp"
+#include "Stats.hpp"
+#include "Univariate.hpp"
 #include "debug.hpp"
 #include <cmath>
 #include <iostream>
@@ -7,9 +9,36 @@ using namespace GiNaC;
 
 template <typename T> using gexmap = map<ex, T, ex_is_less>;
 
+bool SchweighoferTester::squareGenerators = false;
+
+// Factorizations kept by factor_memo, before it starts over
+static const size_t FACTOR_MEMO_SIZE = 1 << 16;
+
+ex factor_memo(const ex &e, unsigned options) {
+  static map<unsigned, gexmap<ex>> memo;
+  static size_t size = 0;
+  gexmap<ex> &factored = memo[options];
+  auto it = factored.find(e);
+  if (it != factored.end()) {
+    DEBUG(9, "Reusing factorization of " << e << ": " << it->second << NL);
+    return it->second;
+  }
+  if (size >= FACTOR_MEMO_SIZE) {
+    DEBUG(5, "Flushing the " << size << " memoized factorizations\n");
+    stats::add("factor_memo.flushes");
+    for (auto &m : memo)
+      m.second.clear();
+    size = 0;
+  }
+  size++;
+  const ex f = factor(e, options);
+  memo[options][e] = f;
+  return f;
+}
+
 SchweighoferTester::SchweighoferTester(exset ineqs, unsigned d)
     : numSrcs(ineqs.size()), problem(nullptr), monomPos({}), ineqPos({}),
-      order(0), MAX_ORDER(std::max(1u, d)) {
+      box(new IntegerBox()), order(0), MAX_ORDER(std::max(1u, d)) {
   // We do a very basic test to avoid doing work for the obvious systems
   if (numSrcs == 0) {
     DEBUG(5, "Empty system == true\n");
@@ -34,19 +63,23 @@ SchweighoferTester::SchweighoferTester(exset ineqs, unsigned d)
     i++;
     DEBUG(5, e << " == added new constraint\n");
   }
-  idx_map indexes;
-  expandSrcs(ineqs, indexes);
-  DEBUG(4, indexes.size() << " number of distinct inequalities\n");
+  *box = IntegerBox(ineqs);
+  srcs = ineqs;
+  if (not loadSnapshot(ineqs)) {
+    idx_map indexes;
+    expandSrcs(ineqs, indexes);
+    DEBUG(4, indexes.size() << " number of distinct inequalities\n");
+    buildProblem(indexes);
+    indexes.clear();
+  }
   ineqs.clear();
-  buildProblem(indexes);
-  indexes.clear();
   glp_term_out(GLP_OFF);
   DEBUGIF(8, "Enabling glpk output\n") { glp_term_out(GLP_ON); }
 }
 
 SchweighoferTester::SchweighoferTester(const sysType &ineqs, unsigned d)
     : numSrcs(ineqs.size()), problem(nullptr), monomPos({}), ineqPos({}),
-      order(0), MAX_ORDER(std::max(1u, d)) {
+      box(new IntegerBox()), order(0), MAX_ORDER(std::max(1u, d)) {
   exset ns;
   for (const auto i : ineqs)
     ns.insert(i.first);
@@ -70,17 +103,25 @@ SchweighoferTester::SchweighoferTester(const sysType &ineqs, unsigned d)
     i++;
     DEBUG(5, e << " == added new constraint\n");
   }
-  idx_map indexes;
-  expandSrcs(ns, indexes);
-  DEBUG(4, indexes.size() << " number of distinct inequalities\n");
+  *box = IntegerBox(ns);
+  srcs = ns;
+  if (not loadSnapshot(ns)) {
+    idx_map indexes;
+    expandSrcs(ns, indexes);
+    DEBUG(4, indexes.size() << " number of distinct inequalities\n");
+    buildProblem(indexes);
+    indexes.clear();
+  }
   ns.clear();
-  buildProblem(indexes);
-  indexes.clear();
   glp_term_out(GLP_OFF);
   DEBUGIF(7, "Enabling glpk output\n") { glp_term_out(GLP_ON); }
 }
 
-SchweighoferTester::~SchweighoferTester() { clear(); }
+SchweighoferTester::~SchweighoferTester() {
+  saveSnapshot();
+  clear();
+  delete box;
+}
 
 bool SchweighoferTester::goodNumbers(const ex &compareTo) const {
   if (glp_get_col_prim(problem, 1) < -0.990 - MAX_ERROR) {
@@ -236,6 +277,43 @@ bool SchweighoferTester::isProved(int o, bool isExact,
 
   return goodNumbers(compareTo);
 }
+testResult SchweighoferTester::factor_sign(const ex &f) {
+  if (excluded != nullptr) // The cached signs are the ones of the full system
+    return test(f);
+  auto it = factorSigns.find(f);
+  if (it != factorSigns.end()) {
+    DEBUG(7, "We have cached that the sign of factor " << f << " is "
+                                                      << it->second << NL);
+    return it->second;
+  }
+  it = factorSigns.find(expand(-f));
+  if (it != factorSigns.end()) {
+    testResult res = it->second;
+    DEBUG(7, "We have cached that the sign of factor minus (" << f << ") is "
+                                                             << res << NL);
+    switch (res.sign) {
+    case SIGN::GEZ:
+      res.sign = SIGN::LEZ;
+      break;
+    case SIGN::GTZ:
+      res.sign = SIGN::LTZ;
+      break;
+    case SIGN::LEZ:
+      res.sign = SIGN::GEZ;
+      break;
+    case SIGN::LTZ:
+      res.sign = SIGN::GTZ;
+      break;
+    default:
+      break;
+    }
+    return res;
+  }
+  testResult res = test(f);
+  factorSigns[f] = res;
+  return res;
+}
+
 testResult SchweighoferTester::test_factorized(ex ineq) {
   DEBUG(6, "Factorizing " << ineq << " for obtaining sign\n");
   assertM(not is_a<numeric>(ineq), "Can't factorize a number");
@@ -249,7 +327,7 @@ testResult SchweighoferTester::test_factorized(ex ineq) {
     assertM(exp.is_nonneg_integer(),
             "Power " << p << " has negative integer exponent " << exp
                      << "!!\n");
-    testResult sub = test(p.op(0));
+    testResult sub = factor_sign(p.op(0));
     switch (sub.sign) {
     case SIGN::ZERO:
     case SIGN::ABSURD:
@@ -282,7 +360,7 @@ testResult SchweighoferTester::test_factorized(ex ineq) {
     assertM(exp.is_nonneg_integer(),
             "Power " << p << " has negative integer exponent " << exp
                      << "!!\n");
-    testResult sub = test(p.op(0));
+    testResult sub = factor_sign(p.op(0));
     switch (sub.sign) {
     case SIGN::ZERO:
     case SIGN::ABSURD:
@@ -308,12 +386,12 @@ testResult SchweighoferTester::test_factorized(ex ineq) {
     }
     }
   }
-  ineq = factor(ineq);
+  ineq = factor_memo(ineq);
   if (is_a<mul>(ineq)) {
     bool positive = true;
     double distance = 1.0;
     for (const ex &op : ineq) {
-      testResult t = test(op);
+      testResult t = factor_sign(op);
       switch (t.sign) {
       case SIGN::ABSURD:
       case SIGN::UNKNOWN:
@@ -349,15 +427,112 @@ testResult SchweighoferTester::test_factorized(ex ineq) {
   return {SIGN::UNKNOWN, 0.0};
 }
 
+testResult SchweighoferTester::test_univariate(const ex &ineq) const {
+  ex x;
+  univariate::poly p;
+  if (not univariate::get(ineq, x, p))
+    return {SIGN::UNKNOWN, 0.0};
+  testResult r = univariate::sign(p, box->get(x));
+  DEBUG(6, "Univariate test of " << ineq << " gives " << r << NL);
+  return r;
+}
+
+testResult SchweighoferTester::undecided(const ex &ineq,
+                                         const testResult &hint) {
+  if (hint.sign != SIGN::UNKNOWN)
+    return hint;
+  return test_factorized(ineq);
+}
+
+// The products of order sources, for order = 0 .. maxOrder
+vector<exset> SchweighoferTester::sourceProducts(unsigned maxOrder) const {
+  vector<exset> out = {{ex(1)}};
+  for (unsigned order = 1; order <= maxOrder; order++) {
+    exset next;
+    for (const ex &s : srcs)
+      for (const ex &p : out.back())
+        next.insert(expand(s * p, 15));
+    out.push_back(next);
+  }
+  return out;
+}
+
+/* The columns of the products src is part of, that is, src times a product
+ * of at most MAX_ORDER - 1 sources, as expandSrcs and addSource build them.
+ * This works the same for a tester loaded from a snapshot. A column that is
+ * also a product without src, as i * n - n for the sources n, i - 1 and
+ * i * n - n, is excluded with src, which only makes the test weaker. */
+const vector<int> &SchweighoferTester::columnsOf(const ex &src) {
+  auto it = srcColumns.find(src);
+  if (it != srcColumns.end())
+    return it->second;
+  if (products.empty())
+    products = sourceProducts(MAX_ORDER - 1);
+  vector<int> cols;
+  for (const exset &ps : products)
+    for (const ex &p : ps) {
+      auto col = ineqPos.find(expand(src * p, 15));
+      if ((col != ineqPos.end()) and (col->second != 1))
+        cols.push_back(col->second);
+    }
+  sort(cols.begin(), cols.end());
+  cols.erase(unique(cols.begin(), cols.end()), cols.end());
+  DEBUG(6, src << " is part of " << cols.size() << " columns\n");
+  return srcColumns.insert({src, cols}).first->second;
+}
+
+bool SchweighoferTester::isExcluded(int column) const {
+  return (excluded != nullptr) and
+         binary_search(excluded->begin(), excluded->end(), column);
+}
+
+testResult SchweighoferTester::testWithout(const ex &src, const ex &ineq,
+                                           bool testPosAndNeg) {
+  const ex s = expand(src);
+  if ((problem == nullptr) or (srcs.find(s) == srcs.end()))
+    return test(ineq, testPosAndNeg);
+  stats::add("tester.exclusions");
+  excluded = &columnsOf(s);
+  // The bounds of the symbols must not come from src either
+  exset others = srcs;
+  others.erase(s);
+  IntegerBox without(others), *full = box;
+  box = &without;
+  const testResult r = test(ineq, testPosAndNeg);
+  box = full;
+  excluded = nullptr;
+  return r;
+}
+
 testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
   DEBUG(6, "Testing " << ineq << NL);
   testResult result = {SIGN::UNKNOWN, 0.0};
   ineq = expand(ineq);
 
+  /* Polynomials in a single symbol are solved exactly over the integer
+   * interval the system implies for that symbol. A strict sign is returned
+   * right away, a non-strict one is kept as the answer if the LP can't do
+   * better. */
+  testResult hint = {SIGN::UNKNOWN, 0.0};
+  if (not is_a<numeric>(ineq)) {
+    hint = test_univariate(ineq);
+    switch (hint.sign) {
+    case SIGN::GTZ:
+    case SIGN::LTZ:
+    case SIGN::ZERO:
+      return hint;
+    default:
+      break;
+    }
+  }
+
   glp_set_col_bnds(problem, 1, GLP_DB, -0.9990, 1.0e6);
   glp_set_obj_coef(problem, 1, 1);
   for (int i = 2; i <= glp_get_num_cols(problem); i++)
     glp_set_col_bnds(problem, i, GLP_LO, 0.0, 0.0);
+  if (excluded != nullptr)
+    for (int col : *excluded)
+      glp_set_col_bnds(problem, col, GLP_FX, 0.0, 0.0);
 
   for (int i = 1, iEnd = monomPos.size(); i <= iEnd; i++)
     glp_set_row_bnds(problem, i, GLP_FX, 0.0, 0.0);
@@ -391,6 +566,8 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
     bool gez = false, lez = false;
     double gtz = 0.0, ltz = 0.0;
     for (const auto &toTest : ineqPos) {
+      if (isExcluded(toTest.second))
+        continue;
       DEBUG(9, "Testing if " << toTest.first << " implies " << ineq << NL);
       ex pos_test = expand(ineq - toTest.first);
       bool this_gez = is_a<numeric>(pos_test) and (pos_test >= 0.0);
@@ -448,7 +625,7 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
     if (it == monomPos.end()) {
       DEBUG(3, "Monomial: " << mon.first << " is not in the st system.\n");
       monomialsCoeffs.clear();
-      return {SIGN::UNKNOWN, 0};
+      return hint;
     }
     glp_set_row_bnds(problem, it->second, GLP_FX, mon.second, mon.second);
     DEBUG(7, "glp_set_row_bnds: " << it->second << '(' << it->first
@@ -470,7 +647,7 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
   if (!isProved(o)) {
     if (!testPosAndNeg) {
       if (result.sign == SIGN::UNKNOWN)
-        return test_factorized(ineq);
+        return undecided(ineq, hint);
       return result;
     }
   } else {
@@ -479,7 +656,7 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
     if (!isProved(o, true, ineq)) {
       if (!testPosAndNeg) {
         if (result.sign == SIGN::UNKNOWN)
-          return test_factorized(ineq);
+          return undecided(ineq, hint);
         return result;
       }
     } else {
@@ -509,7 +686,7 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
   if ((!testPosAndNeg) or
       isNumeric) { // It was requested to verify E >= 0 and -E >= 0?
     if (result.sign == SIGN::UNKNOWN)
-      return test_factorized(ineq);
+      return undecided(ineq, hint);
 
     return result;
   }
@@ -528,14 +705,14 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
   o = glp_simplex(problem, &config);
   if (!isProved(o)) {
     if (result.sign == SIGN::UNKNOWN)
-      return test_factorized(ineq);
+      return undecided(ineq, hint);
     return result;
   }
   //  glp_write_prob(problem, 0, "problem.txt");
   o = glp_exact(problem, &config);
   if (!isProved(o, true, expand(-ineq))) {
     if (result.sign == SIGN::UNKNOWN)
-      return test_factorized(ineq);
+      return undecided(ineq, hint);
 
     return result;
   }
@@ -566,7 +743,7 @@ testResult SchweighoferTester::test(ex ineq, bool testPosAndNeg) {
     assert(false); //??? Forced it to be >= -0.9999999
 
   if (result.sign == SIGN::UNKNOWN)
-    return test_factorized(ineq);
+    return undecided(ineq, hint);
 
   return result;
 }
@@ -628,9 +805,12 @@ void SchweighoferTester::expandSrcs(const exset &root, idx_map &indexes) {
   monomPos[1] = 1;
   ineqPos[1] = 1;
   indexes[1][1] = 1;
-  for (unsigned order = 1; order <= MAX_ORDER; order++) {
+  bool full = false; // Reached the maximum number of columns
+  for (unsigned order = 1; (order <= MAX_ORDER) and not full; order++) {
     DEBUG(8, "Inserting constraints at order " << order << NL);
     for (const ex &rootExp : root) {
+      if (full)
+        break;
       DEBUG(8, "rootExp: " << rootExp << NL);
       for (const ex &prevOrd : expanded[order - 1]) {
         DEBUG(8, "prevOrd = " << prevOrd << NL);
@@ -648,26 +828,139 @@ void SchweighoferTester::expandSrcs(const exset &root, idx_map &indexes) {
           continue;
         DEBUG(7, "Adding constraint " << expanExp << NL);
         expanded[order].insert(expanExp);
-        unsigned column = indexes.size() + 1;
-        DEBUG(7, "\t" << expanExp << " is at column " << column << NL);
-        ineqPos[expanExp] = column;
-        gexmap<double> monomialsCoeffs;
-        gatherMonomials(expanExp, monomialsCoeffs);
-        assert(monomialsCoeffs.size());
-        for (const auto &coefficient : monomialsCoeffs) {
-          size_t row = monomPos[coefficient.first];
-          if (row == 0) {
-            row = monomPos.size();
-            monomPos[coefficient.first] = row;
-          }
-          indexes[column][row] = coefficient.second;
+        addColumn(expanExp, indexes);
+        if (indexes.size() >= 2500) {
+          full = true;
+          break;
         }
-        monomialsCoeffs.clear();
-        if (column >= 2500)
-          return;
       }
     }
   }
+  if (squareGenerators)
+    addSquares(root, indexes);
+  stats::add("tester.builds");
+  stats::add("tester.columns", indexes.size());
+  stats::add("tester.rows", monomPos.size());
+}
+
+unsigned SchweighoferTester::addColumn(const ex &e, idx_map &indexes) {
+  unsigned column = ineqPos.size() + 1;
+  DEBUG(7, "\t" << e << " is at column " << column << NL);
+  ineqPos[e] = column;
+  gexmap<double> monomialsCoeffs;
+  gatherMonomials(e, monomialsCoeffs);
+  assert(monomialsCoeffs.size());
+  for (const auto &coefficient : monomialsCoeffs) {
+    size_t row = monomPos[coefficient.first];
+    if (row == 0) {
+      row = monomPos.size();
+      monomPos[coefficient.first] = row;
+    }
+    indexes[column][row] = coefficient.second;
+  }
+  return column;
+}
+
+void SchweighoferTester::addSource(const ex &src) {
+  const ex e = expand(src);
+  if (srcs.find(e) != srcs.end())
+    return;
+  if (is_a<numeric>(e)) {
+    if (e < 0)
+      clear();
+    return;
+  }
+  srcs.insert(e);
+  numSrcs++;
+  box->insert(e);
+  box->propagate();
+  factorSigns.clear(); // Undecided signs might be decided now
+  srcColumns.clear();
+  products.clear();
+  snapshotPath.clear(); // Not the system it was loaded or expanded for
+  stats::add("tester.added_sources");
+  if (problem == nullptr) {
+    idx_map indexes;
+    expandSrcs(srcs, indexes);
+    buildProblem(indexes);
+    return;
+  }
+
+  // The products of order - 1 sources, E included, each times E
+  idx_map indexes;
+  const size_t nRows = monomPos.size();
+  for (const exset &ps : sourceProducts(MAX_ORDER - 1))
+    for (const ex &p : ps) {
+      if (ineqPos.size() >= 2500)
+        break;
+      const ex product = expand(e * p, 15);
+      if (ineqPos.find(product) != ineqPos.end())
+        continue;
+      DEBUG(7, "Adding constraint " << product << NL);
+      addColumn(product, indexes);
+    }
+  // Only the squares of the symbols E brings are new
+  if (squareGenerators)
+    addSquares(srcs, indexes);
+  stats::add("tester.columns", indexes.size());
+
+  if (monomPos.size() > nRows) {
+    glp_add_rows(problem, monomPos.size() - nRows);
+    for (const auto &mono : monomPos) {
+      if (size_t(mono.second) <= nRows)
+        continue;
+      stringstream ss;
+      ss << mono.first;
+      glp_set_row_name(problem, mono.second, ss.str().c_str());
+    }
+  }
+  if (indexes.empty())
+    return;
+  const int first = glp_add_cols(problem, indexes.size());
+  assert(first == indexes.begin()->first);
+  (void)first;
+  for (const auto &col : indexes) {
+    vector<int> is = {0}; // glpk ignores element [0]
+    vector<double> vs = {0};
+    for (const auto &monomCoeff : col.second) {
+      is.push_back(monomCoeff.first);
+      vs.push_back(monomCoeff.second);
+    }
+    glp_set_mat_col(problem, col.first, col.second.size(), is.data(),
+                    vs.data());
+    glp_set_col_bnds(problem, col.first, GLP_LO, 0.0, 0.0);
+    glp_set_obj_coef(problem, col.first, 0);
+  }
+}
+
+void SchweighoferTester::addSquares(const exset &root, idx_map &indexes) {
+  // b = {1} U symbols(S); add b_i^2, (b_i - b_j)^2 and (b_i + b_j)^2
+  exset symbs;
+  for (const ex &e : root)
+    for (ex::const_preorder_iterator i = e.preorder_begin(),
+                                     iEnd = e.preorder_end();
+         i != iEnd; ++i)
+      if (is_a<symbol>(*i))
+        symbs.insert(*i);
+
+  vector<ex> base = {ex(1)};
+  base.insert(base.end(), symbs.begin(), symbs.end());
+  const size_t before = indexes.size();
+  auto add = [&](const ex &sq) {
+    ex e = expand(sq);
+    if (ineqPos.find(e) != ineqPos.end())
+      return;
+    DEBUG(7, "Adding square generator " << e << NL);
+    addColumn(e, indexes);
+  };
+  for (size_t i = 1; i < base.size(); i++)
+    add(pow(base[i], 2));
+  for (size_t i = 0; i < base.size(); i++)
+    for (size_t j = i + 1; j < base.size(); j++) {
+      add(pow(base[i] - base[j], 2));
+      add(pow(base[i] + base[j], 2));
+    }
+  stats::add("tester.square_columns", indexes.size() - before);
 }
 
 void SchweighoferTester::buildProblem(const idx_map &indexes) {
@@ -717,6 +1010,7 @@ void SchweighoferTester::clear() {
   numSrcs = 0;
   monomPos.clear();
   ineqPos.clear();
+  factorSigns.clear();
   if (problem) {
     glp_delete_prob(problem);
     problem = nullptr;
@@ -48,19 +48,41 @@ enum SIGN : unsigned char { // Possible signs our system S implies for a tested
              // least one of c0 or c1 is greater than zero.
 };
 
+class IntegerBox;
+
 typedef struct {
   SIGN sign; // Return if the system implies an expressions holds this sign
   double distance; // Tells by how much the expression holds the given sign
 } testResult;
 
+/* Process wide memo of GiNaC::factor. Factorizing is one of the most
+ * expensive calls we make, and the same expressions are factorized on every
+ * pass of the Simplifier, by every tester and by the printers. It starts
+ * over once it holds FACTOR_MEMO_SIZE of them, so it does not grow for the
+ * whole run. */
+ex factor_memo(const ex &e, unsigned options = 0);
+
 struct SchweighoferTester {
   typedef gexmap<int> exPos;
 
   SchweighoferTester(exset ineqs, unsigned d = 2);
   SchweighoferTester(const sysType &ineqs, unsigned d = 2);
   virtual ~SchweighoferTester();
+  // It owns its LP and its IntegerBox
+  SchweighoferTester(const SchweighoferTester &) = delete;
+  SchweighoferTester &operator=(const SchweighoferTester &) = delete;
 
   testResult test(ex ineq, bool testPosAndNeg = true);
+  /* Test ineq against the system without the source src, as in redundancy
+   * checks. Every column whose product involves src is fixed to zero, so the
+   * n checks of a system share one LP, and its warm basis, instead of
+   * expanding n testers. */
+  testResult testWithout(const ex &src, const ex &ineq,
+                         bool testPosAndNeg = true);
+  /* Add the source E >= 0 to the system. Only the products involving E are
+   * expanded, and appended to the LP as new columns and rows, so growing a
+   * system one constraint at a time costs about one expansion in total. */
+  void addSource(const ex &src);
 
   bool hasChanges() const;
   ostream &printResult(ostream &o, const bool printSteps = false) const;
@@ -69,8 +91,25 @@ struct SchweighoferTester {
 
   const exPos &getMonomials() const { return monomPos; }
 
+  // Integer bounds of the symbols implied by the linear source constraints
+  const IntegerBox &getBox() const { return *box; }
+
+  /* Also use the squares b_i^2, (b_i - b_j)^2 and (b_i + b_j)^2, for b in {1}
+   * U symbols(S), as non-negative generators. This is a DSOS like relaxation
+   * that proves expressions as n^2 - 2n + 1, that are not products of S. */
+  static bool squareGenerators;
+
+  /* Directory of the tester snapshots (see Snapshot.cpp). When set, a tester
+   * expanded from a new set of sources is saved there when destroyed, and a
+   * later tester with the same sources and degree is mmap loaded from it, with
+   * its last basis, instead of being expanded again. */
+  static string snapshotDir;
+
 private:
+  testResult test_univariate(const ex &ineq) const;
+  testResult undecided(const ex &ineq, const testResult &hint);
   testResult test_factorized(ex ineq);
+  testResult factor_sign(const ex &f);
   bool goodNumbers(const ex &compareTo)
       const; // Hack: The simplex algorithm might be interrupted due
              // iteration/time limits, but it might already have good values
@@ -83,17 +122,33 @@ private:
 
   void gatherMonomials(const ex &ineq, gexmap<double> &coeffs);
   void expandSrcs(const exset &root, idx_map &indexes);
+  unsigned addColumn(const ex &e, idx_map &indexes);
+  void addSquares(const exset &root, idx_map &indexes);
   void buildProblem(const idx_map &indexes);
   void clear();
+  bool loadSnapshot(const exset &srcs);
+  void saveSnapshot() const;
+  vector<exset> sourceProducts(unsigned maxOrder) const;
+  const vector<int> &columnsOf(const ex &src);
+  bool isExcluded(int column) const;
   size_t numSrcs;
+  exset srcs; // The sources, without the numeric ones
   glp_prob *problem;
   exPos monomPos; // Holds monomial positions on the glpk problem (row number)
   exPos ineqPos;  // Holds expressions position on the glpk problem (column
                   // number) !!!!!PS!!!! We do not hold numeric values. For
                   // example: 4N-3x+2 will turn into 4N-3x.
+  IntegerBox *box;
+  gexmap<testResult> factorSigns; // Signs of the factors already solved by
+                                  // test_factorized, such as n, n-1, tsteps
+  gexmap<vector<int>> srcColumns; // Sorted columns involving each source
+  vector<exset> products;         // sourceProducts for columnsOf
+  const vector<int> *excluded = nullptr; // Columns fixed to zero by testWithout
   unsigned order;
   unsigned MAX_ORDER;
   unsigned shrinkIterations;
+  string snapshotPath; // Where to save this tester, empty if loaded
+  string snapshotSrcs; // Canonical sources, checked when loading
 };
 
 namespace std {
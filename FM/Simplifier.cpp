@@ -15,18 +15,28 @@
 ///
 //===----------------------------------------------------------------------===//
 #include "Simplifier.hpp"
+#include "Hermite.hpp"
+#include "Parallel.hpp"
+#include "Planner.hpp"
 #include <array>
 #include <cmath>
+#include <cstring>
 #include <ginac/ginac.h>
 
 #include "debug.hpp"
 
+/* Least number of Fourier-Motzkin pairs expanded by the workers. Each worker
+ * costs a fork, and each pair a print and a parse on top of its expansion, so
+ * a handful of pairs is expanded faster here. Tune it with -s, comparing
+ * motzkin.parallel_pairs to the run time. */
+static const size_t PARALLEL_PAIRS = 64;
+
 #ifdef SCRIPT_CONTROL
 #define returnAbsurd()                                                         \
   ;                                                                            \
   {                                                                            \
     cerr << __FILENAME__ << "::" << __func__ << "::" << __LINE__ << NL;        \
-    tester->printResult(cerr);                                                 \
+    getTester()->printResult(cerr);                                            \
     cout.flush();                                                              \
     cerr.flush();                                                              \
     cout << Conjunction::absurd << NL;                                         \
@@ -44,10 +54,16 @@
   while (0)
 #endif
 
+/* The whole input is true, unless it is a component of decompose, that
+ * only makes its part true */
 #define returnObvious()                                                        \
   {                                                                            \
-    cout << Conjunction::obvious << NL;                                        \
-    exit(0);                                                                   \
+    if (nesting == 0) {                                                        \
+      cout << Conjunction::obvious << NL;                                      \
+      exit(0);                                                                 \
+    }                                                                          \
+    conju = Conjunction::obvious;                                              \
+    ret.push_back(Conjunction::obvious);                                       \
   }
 #define sanityCheck()                                                          \
   {                                                                            \
@@ -60,26 +76,23 @@
     }                                                                          \
   }
 
-void Simplifier::build_tester() {
-  clear();
-  exset sys;
-  if (Conjunction::absurd == conju)
-    sys.insert(-1);
-  else if (!(Conjunction::obvious == conju)) {
-    for (cc c : conju.ineqs)
-      sys.insert(c->exp);
-    for (cc c : conju.eqs) {
-      sys.insert(c->exp);
-      sys.insert(-c->exp);
-    }
-  }
-  DEBUGIF(6, "Tester received this set of constraints:\n") {
-    int i = 1;
-    for (const ex &e : sys)
-      cerr << i++ << "  " << e << NL;
+namespace {
+/* Runs the n independent tests over the workers, returning the results in
+ * item order. The tester must be built before, so the workers inherit it
+ * instead of each building its own. */
+vector<testResult> testAll(size_t n, const function<testResult(size_t)> &test) {
+  vector<string> res = parallel::map(n, [&test](size_t i) {
+    const testResult tr = test(i);
+    return string(reinterpret_cast<const char *>(&tr), sizeof(tr));
+  });
+  vector<testResult> trs(n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i].size() == sizeof(testResult));
+    memcpy(&trs[i], res[i].data(), sizeof(testResult));
   }
-  tester = new SchweighoferTester(sys);
+  return trs;
 }
+} // namespace
 
 void Simplifier::split_space(const exset &pars) {
   // If there are unknown or non strict relationship between 2 of these
@@ -88,7 +101,9 @@ void Simplifier::split_space(const exset &pars) {
        p1++) {
     for (exset::const_iterator p2 = next(p1); p2 != pEnd; p2++) {
       ex tt = (*p1) - (*p2);
-      testResult tr = tester->test(tt);
+      // The branches are checked against this system, not the changed conju
+      SchweighoferTester *parent = getTester();
+      testResult tr = parent->test(tt);
       DEBUG(2, "Sign of " << tt << ":" << tr << NL);
       if (tr.sign == SIGN::ABSURD) {
         returnAbsurd();
@@ -108,8 +123,8 @@ void Simplifier::split_space(const exset &pars) {
         clear();
         exit(0);
 #else
-        ret.push_back(cltz);
-        build_tester();
+        branch(parent, cltz, -tt - 1);
+        reset_tester();
         return;
 #endif
       }
@@ -122,8 +137,8 @@ void Simplifier::split_space(const exset &pars) {
         clear();
         exit(0);
 #else
-        ret.push_back(cgtz);
-        build_tester();
+        branch(parent, cgtz, tt - 1);
+        reset_tester();
         return;
 #endif
       }
@@ -138,9 +153,9 @@ void Simplifier::split_space(const exset &pars) {
         clear();
         exit(0);
 #else
-        ret.push_back(cgtz);
-        ret.push_back(cltz);
-        build_tester();
+        branch(parent, cgtz, tt - 1);
+        branch(parent, cltz, -tt - 1);
+        reset_tester();
         return;
 #endif
       }
@@ -153,6 +168,34 @@ void Simplifier::split_space(const exset &pars) {
   }
 }
 
+void Simplifier::branch(SchweighoferTester *parent, const Conjunction &child,
+                        const ex &added) {
+  bool empty = Conjunction::absurd == child;
+  if (not empty) {
+    IntegerBox box = parent->getBox();
+    box.insert(added);
+    box.propagate();
+    empty = box.empty();
+  }
+  if (not empty)
+    switch (parent->test(expand(-added - 1), false).sign) {
+    case SIGN::GEZ:
+    case SIGN::GTZ:
+    case SIGN::ZERO:
+    case SIGN::ABSURD:
+      empty = true;
+      break;
+    default:
+      break;
+    }
+  if (empty) {
+    DEBUG(2, "Dropping the empty branch with " << added << GE << "0\n");
+    stats::add("simplifier.empty_branches");
+    return;
+  }
+  ret.push_back(child);
+}
+
 Simplifier::relat Simplifier::put_in_evidence(ex exp, const exset &vars) const {
   if (vars.size() == 1) {
     ex v = *vars.begin();
@@ -232,19 +275,19 @@ bool Simplifier::eqs_affinize() {
     DEBUG(4, '(' << factorized.evidence << ") * (" << factorized.quo
                  << ") = " << factorized.rhs << NL);
 
-    SIGN sEVI = tester->test(factorized.evidence).sign;
+    SIGN sEVI = getTester()->test(factorized.evidence).sign;
     if (sEVI == SIGN::ABSURD) {
       returnAbsurd();
       return true;
     }
 
-    SIGN sQUO = tester->test(factorized.quo).sign;
+    SIGN sQUO = getTester()->test(factorized.quo).sign;
     if (sQUO == SIGN::ABSURD) {
       returnAbsurd();
       return true;
     }
 
-    SIGN sRHS = tester->test(factorized.rhs).sign;
+    SIGN sRHS = getTester()->test(factorized.rhs).sign;
     if (sRHS == SIGN::ABSURD) {
       returnAbsurd();
       return true;
@@ -707,11 +750,11 @@ bool Simplifier::eqs_affinize() {
     } else if (sEVI & (SIGN::GTZ | SIGN::LTZ)) {
       testResult sEviRhs;
       if (sEVI & sRHS & (~SIGN::ZERO)) {
-        sEviRhs = tester->test(
+        sEviRhs = getTester()->test(
             factorized.evidence -
             factorized.rhs); // rhs and evi have same sign (G?Z or L?Z)
       } else {
-        sEviRhs = tester->test(
+        sEviRhs = getTester()->test(
             factorized.evidence +
             factorized.rhs); // rhs and evi have distinct sign (G?Z and L?Z)
       }
@@ -846,10 +889,10 @@ bool Simplifier::eqs_affinize() {
     } else if (sQUO & (SIGN::GTZ | SIGN::LTZ)) {
       testResult sRemRhs;
       if (sQUO & sRHS & (~SIGN::ZERO)) {
-        sRemRhs = tester->test(factorized.quo - factorized.rhs);
+        sRemRhs = getTester()->test(factorized.quo - factorized.rhs);
         // QUO and rhs have same sign (G?Z or L?Z)
       } else {
-        sRemRhs = tester->test(factorized.quo + factorized.rhs);
+        sRemRhs = getTester()->test(factorized.quo + factorized.rhs);
         // QUO and rhs have distinct sign (G?Z and L?Z)
       }
       if (sRemRhs.sign != SIGN::UNKNOWN) {
@@ -987,41 +1030,178 @@ bool Simplifier::eqs_affinize() {
 }
 
 Simplifier::Simplifier(Conjunction &s) : conju(s) {}
+bool Simplifier::pass(Pass p, const function<bool()> &run) {
+  static const char *const names[NPASSES] = {
+      "affinize", "pattern",   "gaussian",  "planes",
+      "roots",    "normalize", "tightening"};
+  const ConstraintSet all = conju.eqs | conju.ineqs;
+  const bool sameVars = conju.vars == seenVars[p];
+  const ConstraintSet dirty = sameVars ? all - seen[p] : all;
+  const string name = string("simplifier.") + names[p];
+  if (dirty.empty()) {
+    DEBUG(5, "Nothing changed since the last " << names[p] << " pass\n");
+    stats::add(name + ".skipped", all.size());
+    return false;
+  }
+  Symbols touched;
+  for (cc c : dirty)
+    touched |= c->symbs;
+  const ConstraintSet outerFocus = focus;
+  const bool outerFocused = focused;
+  focus = dirty;
+  for (cc c : all)
+    if (c->symbs.intersects(touched))
+      focus.insert(c);
+  focused = sameVars;
+  stats::add(name + ".visited", focus.size());
+  stats::add(name + ".skipped", all.size() - focus.size());
+  const bool changed = run();
+  focus = outerFocus;
+  focused = outerFocused;
+  if (not changed) {
+    seen[p] = all;
+    seenVars[p] = conju.vars;
+  }
+  return changed;
+}
+
+unsigned Simplifier::nesting = 0;
+
+bool Simplifier::decompose() {
+#ifdef SCRIPT_CONTROL
+  return false; // The scripts follow a single system
+#endif
+  vector<Symbols> compVars;
+  vector<ConstraintSet> comps;
+  ConstraintSet free; // Constraints without variables, given to every one
+  for (cc c : conju.eqs | conju.ineqs) {
+    Symbols v = c->symbs & conju.vars;
+    if (v.empty()) {
+      free.insert(c);
+      continue;
+    }
+    ConstraintSet comp = {c};
+    for (size_t i = 0; i < comps.size();) {
+      if (not compVars[i].intersects(v)) {
+        i++;
+        continue;
+      }
+      v |= compVars[i];
+      comp |= comps[i];
+      compVars.erase(compVars.begin() + i);
+      comps.erase(comps.begin() + i);
+    }
+    compVars.push_back(v);
+    comps.push_back(comp);
+  }
+  if (comps.size() < 2)
+    return false;
+  DEBUG(0, "The system has " << comps.size() << " independent components\n");
+  stats::add("simplifier.components", comps.size());
+
+  auto eliminate = [&](size_t i) {
+    Disjunction d;
+    d.join(
+        {Conjunction(compVars[i], conju.pars, comps[i] | free, conju.id())});
+    nesting++;
+    d.eliminateVariables();
+    nesting--;
+    return Conjs(d.begin(), d.end());
+  };
+  vector<Conjs> results(comps.size());
+  if (parallel::jobs > 1) {
+    // Sent back printed, each conjunction ending with ;, as Disjunction reads
+    vector<string> res = parallel::map(comps.size(), [&eliminate](size_t i) {
+      stringstream ss;
+      for (const Conjunction &r : eliminate(i))
+        ss << r << NL;
+      return ss.str();
+    });
+    for (size_t i = 0; i < comps.size(); i++) {
+      stringstream ss(res[i]);
+      Disjunction d;
+      d.read(ss);
+      results[i].assign(d.begin(), d.end());
+    }
+  } else
+    for (size_t i = 0; i < comps.size(); i++)
+      results[i] = eliminate(i);
+
+  vector<ConstraintSet> prods = {ConstraintSet()};
+  for (const Conjs &r : results) {
+    vector<ConstraintSet> next;
+    for (const ConstraintSet &p : prods)
+      for (const Conjunction &q : r)
+        if (not(Conjunction::absurd == q))
+          next.push_back(p | q.eqs | q.ineqs);
+    if (next.empty()) {
+      DEBUG(0, "A component has no solution\n");
+      returnAbsurd();
+      return true;
+    }
+    prods.swap(next);
+  }
+  for (const ConstraintSet &p : prods) {
+    if (p.empty()) {
+      ret.push_back(Conjunction::obvious);
+      continue;
+    }
+    // The parts of the components might be simpler together
+    Conjunction nc(Symbols(), conju.pars, p, conju.id());
+    if (nc.hasInverseConstraints())
+      continue;
+    Simplifier s(nc);
+    nesting++;
+    s.run();
+    nesting--;
+    for (const Conjunction &r : s.get())
+      if (not(Conjunction::absurd == r))
+        ret.push_back(r);
+  }
+  if (ret.empty()) {
+    returnAbsurd();
+  }
+  return true;
+}
+
 void Simplifier::run() {
   while (true) {
     conju.detectEqs();
     DEBUG(0, "System (size: " << conju.size() << ") is:\n" << conju << NL);
+    if (decompose())
+      return;
     do {
       sanityCheck();
       DEBUG(5, conju << NL);
-      build_tester();
-    } while (eqs_affinize() || eqs_pattern_matching() ||
-             gaussian_replacement());
+      reset_tester();
+    } while (pass(AFFINIZE, [this] { return eqs_affinize(); }) ||
+             pass(PATTERN, [this] { return eqs_pattern_matching(); }) ||
+             pass(GAUSSIAN, [this] { return gaussian_replacement(); }));
 
     if (conju.size() < 30) {
-      if (add_affine_planes()) {
+      if (pass(PLANES, [this] { return add_affine_planes(); })) {
         sanityCheck();
         DEBUG(0, "System after adding affine planes:\n" << conju);
-        build_tester();
+        reset_tester();
       }
     } else {
-      if (getRoots()) {
+      if (pass(ROOTS, [this] { return getRoots(); })) {
         DEBUG(0, "System after roots search:\n" << conju);
-        build_tester();
+        reset_tester();
       }
     }
 
-    if (normalize()) {
+    if (pass(NORMALIZE, [this] { return normalize(); })) {
       DEBUG(0, "System after obtaining roots:\n" << conju);
       sanityCheck();
-      build_tester();
+      reset_tester();
     }
 
     if (conju.size() < 100) {
-      if (tightening()) {
+      if (pass(TIGHTENING, [this] { return tightening(); })) {
         DEBUG(0, "System after tightening constraints:\n" << conju);
         sanityCheck();
-        build_tester();
+        reset_tester();
       }
     }
     DEBUG(0, "System after treating equalities (size: " << conju.size()
@@ -1030,14 +1210,14 @@ void Simplifier::run() {
     if (!conju.hasVariables()) {
       DEBUG(0, "Done removing all variables");
       sanityCheck();
-      getRoots();
-      normalize();
+      pass(ROOTS, [this] { return getRoots(); });
+      pass(NORMALIZE, [this] { return normalize(); });
       DEBUG(0, "System after roots search:\n" << conju);
-      while (tightening()) {
-        getRoots();
+      while (pass(TIGHTENING, [this] { return tightening(); })) {
+        pass(ROOTS, [this] { return getRoots(); });
         conju.detectEqs();
         DEBUG(0, "Could still reduce simplified system to:\n" << conju);
-        build_tester();
+        reset_tester();
       }
       sanityCheck();
       ret.push_back(conju);
@@ -1060,14 +1240,14 @@ void Simplifier::run() {
     }
     DEBUG(0, "Giving the system:\n" << conju);
 
-    testResult val = tester->test(ex(-1), false);
+    testResult val = getTester()->test(ex(-1), false);
     switch (val.sign) {
     case SIGN::LTZ: {
       if (val.distance == 1.0)
         break;
       /* no break */
       cerr << "Got SIGN " << val << " to expression (-1)!!! ABSURD!!\n";
-      tester->printResult(cerr, true);
+      getTester()->printResult(cerr, true);
       returnAbsurd();
       return;
     }
@@ -1077,7 +1257,7 @@ void Simplifier::run() {
     case SIGN::ZERO:
     case SIGN::ABSURD: {
       cerr << "Got SIGN " << val << " to expression (-1)!!! ABSURD!!\n";
-      tester->printResult(cerr, true);
+      getTester()->printResult(cerr, true);
       returnAbsurd();
       return;
     }
@@ -1142,6 +1322,8 @@ bool Simplifier::eqs_pattern_matching() {
   bool changed = false;
   Constraints newEqs, delEqs;
   for (cc eq : conju.eqs) {
+    if (not inFocus(eq))
+      continue;
     DEBUG(5, "Testing equality " << eq << NL);
 
     for (const ex &p : conju.pars) {
@@ -1157,7 +1339,7 @@ bool Simplifier::eqs_pattern_matching() {
         if (is_a<numeric>(lhs))
           break;
 
-        testResult ts = tester->test(term);
+        testResult ts = getTester()->test(term);
         DEBUG(5, '\t' << term << " == " << ts << NL);
         switch (ts.sign) {
         case SIGN::ABSURD: {
@@ -1188,7 +1370,7 @@ bool Simplifier::eqs_pattern_matching() {
         /*Now we have that term >= 0.
          * To test |term| >= |rhs| we test if term +- rhs >= 0 depending on sign
          * of rhs */
-        testResult rhsS = tester->test(rhs);
+        testResult rhsS = getTester()->test(rhs);
         DEBUG(5, '\t' << rhs << " == " << rhsS << NL);
         ex toTest = term;
         switch (rhsS.sign) {
@@ -1219,7 +1401,7 @@ bool Simplifier::eqs_pattern_matching() {
         default:
           assert(false);
         }
-        testResult tr = tester->test(toTest);
+        testResult tr = getTester()->test(toTest);
         DEBUG(5, "\tTesting if bigger:" << toTest << " = " << tr << NL);
         switch (tr.sign) {
         case SIGN::ABSURD: {
@@ -1266,7 +1448,7 @@ bool Simplifier::add_affine_planes() {
   Constraints toJoin;
   for (auto p1 = conju.pars.begin(), pEnd = conju.pars.end(); p1 != pEnd;
        p1++) {
-    testResult tr = tester->test(*p1);
+    testResult tr = getTester()->test(*p1);
     DEBUG(5, "Testing " << *p1 << " got : " << tr << NL);
     if (tr.sign == SIGN::ABSURD) {
       returnAbsurd();
@@ -1278,7 +1460,7 @@ bool Simplifier::add_affine_planes() {
 
     for (auto p2 = std::next(p1); p2 != pEnd; p2++) {
       ex p1Pp2 = *p1 + *p2;
-      tr = tester->test(p1Pp2);
+      tr = getTester()->test(p1Pp2);
       DEBUG(5, "Testing " << p1Pp2 << " got : " << tr << NL);
 
       if (tr.sign == SIGN::ABSURD) {
@@ -1291,7 +1473,7 @@ bool Simplifier::add_affine_planes() {
             (conju.ineqs.insert(Constraint::get(compose(tr, p1Pp2))).second);
 
       ex p1Mp2 = *p1 - *p2;
-      tr = tester->test(p1Mp2);
+      tr = getTester()->test(p1Mp2);
       DEBUG(5, "Testing " << p1Mp2 << " got : " << tr << NL);
 
       if (tr.sign == SIGN::ABSURD) {
@@ -1307,7 +1489,7 @@ bool Simplifier::add_affine_planes() {
 
   for (auto v1 = conju.vars.begin(), vEnd = conju.vars.end(); v1 != vEnd;
        v1++) {
-    testResult tr = tester->test(*v1);
+    testResult tr = getTester()->test(*v1);
     DEBUG(5, "Testing " << *v1 << " got : " << tr << NL);
 
     if (tr.sign == SIGN::ABSURD) {
@@ -1320,7 +1502,7 @@ bool Simplifier::add_affine_planes() {
 
     for (auto v2 = std::next(v1); v2 != vEnd; v2++) {
       ex v1Pv2 = *v1 + *v2;
-      tr = tester->test(v1Pv2);
+      tr = getTester()->test(v1Pv2);
       DEBUG(5, "Testing " << v1Pv2 << " got : " << tr << NL);
       if (tr.sign == SIGN::ABSURD) {
         returnAbsurd();
@@ -1334,7 +1516,7 @@ bool Simplifier::add_affine_planes() {
       ex v1Mv2 = *v1 - *v2;
       DEBUG(5, "Testing " << v1Mv2 << " got : " << tr << NL);
 
-      tr = tester->test(v1Mv2);
+      tr = getTester()->test(v1Mv2);
       if (tr.sign == SIGN::ABSURD) {
         returnAbsurd();
         return true;
@@ -1350,7 +1532,7 @@ bool Simplifier::add_affine_planes() {
       ex p1Pv1 = *p1 + *v1;
       DEBUG(5, "Testing " << p1Pv1 << " got : " << tr << NL);
 
-      tr = tester->test(p1Pv1);
+      tr = getTester()->test(p1Pv1);
       if (tr.sign == SIGN::ABSURD) {
         returnAbsurd();
         return true;
@@ -1363,7 +1545,7 @@ bool Simplifier::add_affine_planes() {
       ex p1Mv1 = *p1 - *v1;
       DEBUG(5, "Testing " << p1Mv1 << " got : " << tr << NL);
 
-      tr = tester->test(p1Mv1);
+      tr = getTester()->test(p1Mv1);
       if (tr.sign == SIGN::ABSURD) {
         returnAbsurd();
         return true;
@@ -1383,18 +1565,32 @@ bool Simplifier::tightening() {
 
   Constraints addExs, removeExs;
   DEBUG(0, "Tightening the system " << conju << NL);
+  /* The tests are all against the same system, so with more than one job
+   * they are done upfront by the workers, and consumed below in the order
+   * they would have been done. */
+  vector<cc> tested;
+  vector<testResult> trs;
+  if (parallel::jobs > 1) {
+    for (cc c : conju.ineqs)
+      if (inFocus(c))
+        tested.push_back(c);
+    SchweighoferTester *t = getTester();
+    if (tested.size() > 1)
+      trs = testAll(tested.size(), [t, &tested](size_t i) {
+        return t->testWithout(tested[i]->exp, tested[i]->exp);
+      });
+  }
+  size_t k = 0;
   for (cc c : conju.ineqs) {
-    Conjunction other = conju;
-    bool r = other.removeJoin({c}, {});
-    if (!r) {
-      assertM(false,
-              "Failed to remove an constraint from the duplicated system!!\n");
-    }
-    testResult tr = other.getTester()->test(c->exp);
+    if (not inFocus(c))
+      continue;
+    // Test c against the system without it
+    testResult tr = trs.empty() ? getTester()->testWithout(c->exp, c->exp)
+                                : trs[k++];
     DEBUG(8, "Got " << tr << " when testing the constraint " << c
-                    << " against the system\n"
-                    << other << NL);
-    switch (other.getTester()->test(c->exp).sign) {
+                    << " against the rest of the system\n"
+                    << conju << NL);
+    switch (tr.sign) {
     case SIGN::ABSURD:
     case SIGN::LTZ: {
       returnAbsurd();
@@ -1410,7 +1606,7 @@ bool Simplifier::tightening() {
     case SIGN::GEZ: {
       if (!conju.hasVariables()) {
         conju.removeJoin({c}, {});
-        build_tester();
+        reset_tester();
         tightening();
         return true;
       }
@@ -1419,7 +1615,7 @@ bool Simplifier::tightening() {
     case SIGN::GTZ: {
       if (!conju.hasVariables()) {
         conju.removeJoin({c}, {});
-        build_tester();
+        reset_tester();
         tightening();
         return true;
       }
@@ -1476,9 +1672,38 @@ bool Simplifier::getRoots() {
     minSize++;
     if (constraintsBySize.find(minSize) == constraintsBySize.end())
       continue;
-    for (cc c : constraintsBySize[minSize]) {
+    /* With more than one job, the constraints of this size are first tested
+     * by the workers against the system as it is now. A constraint implied
+     * by it is also implied once others are joined, so that answer is kept;
+     * the others are tested again if the system grew meanwhile. */
+    vector<cc> tested;
+    vector<testResult> trs;
+    if (parallel::jobs > 1) {
+      for (cc c : constraintsBySize[minSize])
+        if (inFocus(c))
+          tested.push_back(c);
       SchweighoferTester *nt = nc.getTester();
-      testResult tr = nt->test(c->exp, false);
+      if (tested.size() > 1)
+        trs = testAll(tested.size(), [nt, &tested](size_t i) {
+          return nt->test(tested[i]->exp, false);
+        });
+    }
+    size_t k = 0;
+    bool grown = false;
+    for (cc c : constraintsBySize[minSize]) {
+      if (not inFocus(c)) {
+        grown |= nc.joinGrowingTester(c);
+        continue;
+      }
+      testResult tr = {SIGN::UNKNOWN, 0.0};
+      if (not trs.empty())
+        tr = trs[k++];
+      const bool implied = (tr.sign == SIGN::GEZ) or
+                           (tr.sign == SIGN::GTZ) or (tr.sign == SIGN::ZERO);
+      if (trs.empty() or (grown and not implied)) {
+        SchweighoferTester *nt = nc.getTester();
+        tr = nt->test(c->exp, false);
+      }
       DEBUG(4, "The expression " << c->exp << " is " << tr << NL);
       switch (tr.sign) {
       case SIGN::ABSURD: {
@@ -1497,7 +1722,7 @@ bool Simplifier::getRoots() {
       default: {
         DEBUG(7, "The constraint " << c << " is not implied " << tr << " by:\n"
                                    << nc << NL);
-        nc.removeJoin({}, {c});
+        grown |= nc.joinGrowingTester(c);
       }
       }
     }
@@ -1505,7 +1730,8 @@ bool Simplifier::getRoots() {
   if (removed) {
     conju.eqs = nc.eqs;
     conju.ineqs = nc.ineqs;
-    build_tester();
+    conju.takeTester(nc);
+    reset_tester();
     DEBUG(4, "Removed " << removed
                         << " redundant constraints.\nThe system is now:"
                         << conju << NL);
@@ -1519,13 +1745,15 @@ bool Simplifier::normalize() {
   // = 0
   Constraints toAdd, toRemove;
   for (cc c : conju.ineqs) {
+    if (not inFocus(c))
+      continue;
     bool simplified = false;
     if (is_a<symbol>(c->exp) or is_a<symbol>(expand(-c->exp))) {
       DEBUG(9, c->exp << " is a symbol. Can't do magic, (yet :)" << c << NL)
       continue;
     }
-    ex lhs = factor(c->exp, factor_options::all);
-    ex m_lhs = factor(expand(-c->exp), factor_options::all);
+    ex lhs = factor_memo(c->exp, factor_options::all);
+    ex m_lhs = factor_memo(expand(-c->exp), factor_options::all);
     if (is_a<power>(lhs) or (is_a<power>(m_lhs))) {
       DEBUG(4, c->exp << " is a power, or -power expression" << NL)
       bool neg_is_a_pow = is_a<power>(m_lhs);
@@ -1577,7 +1805,7 @@ bool Simplifier::normalize() {
           }
           continue;
         }
-        testResult tr = tester->test(e);
+        testResult tr = getTester()->test(e);
         switch (tr.sign) {
         case SIGN::LEZ:
         case SIGN::GEZ:
@@ -1632,12 +1860,12 @@ bool Simplifier::normalize() {
     bool negate = false;
     bool factored = false;
     while (df <= 20) {
-      lhs = factor(expand(c->exp + df));
+      lhs = factor_memo(expand(c->exp + df));
       if (is_a<mul>(lhs) or is_a<power>(lhs)) {
         factored = true;
         break;
       }
-      lhs = factor(expand(c->exp - df));
+      lhs = factor_memo(expand(c->exp - df));
       if (is_a<mul>(lhs) or is_a<power>(lhs)) {
         factored = true;
         negate = true;
@@ -1655,7 +1883,7 @@ bool Simplifier::normalize() {
         assert(is_a<mul>(lhs));
         DEBUG(0, lhs << " has been factored!!!");
         for (const ex &e : lhs) {
-          testResult tr = tester->test(e);
+          testResult tr = getTester()->test(e);
           DEBUG(0, "The sign of:" << e << " is: " << tr);
           if (tr.sign == SIGN::ABSURD) {
             DEBUG(0, "Abs!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!");
@@ -1687,11 +1915,65 @@ bool Simplifier::normalize() {
 
 Simplifier::~Simplifier() { clear(); }
 
-void Simplifier::clear() {
-  if (nullptr != tester) {
-    delete tester;
-    tester = nullptr;
+void Simplifier::clear() { tester = nullptr; }
+
+/* The equalities linear, with integer coefficients, in the variables are
+ * reduced together by hermite::reduce. Each pivot variable is then replaced in
+ * the rest of the system in a single traversal, multiplying a constraint by
+ * the pivot coefficient to the degree of the variable in it, as
+ * gaussian_replacement does. Only the non linear equalities are left to
+ * gaussian_replacement. */
+bool Simplifier::linear_elimination() {
+  const vector<ex> vars(conju.vars.begin(), conju.vars.end());
+  vector<ex> exps;
+  Constraints linears;
+  for (cc c : conju.eqs) {
+    vector<numeric> coeffs;
+    ex cst;
+    if ((conju.varsDegree(c->exp) == 1) and
+        hermite::linear(c->exp, vars, coeffs, cst)) {
+      linears.insert(c);
+      exps.push_back(c->exp);
+    }
+  }
+  vector<hermite::Pivot> pivots;
+  vector<ex> rest;
+  if (exps.empty() or (not hermite::reduce(exps, vars, pivots, rest)))
+    return false;
+
+  lst replace;
+  for (const hermite::Pivot &p : pivots) {
+    DEBUG(4, "==> Eliminated variable " << p.var << " = (" << p.rhs << ") / "
+                                        << p.coeff << NL);
+    replace.append(p.var == p.rhs / p.coeff);
   }
+  Constraints toRemove = linears, toAdd;
+  for (const ex &e : rest)
+    toAdd.insert(Constraint::get(e, true));
+  auto replaced = [&](cc c) {
+    ex m = 1;
+    bool has = false;
+    for (const hermite::Pivot &p : pivots) {
+      const int d = degree(c->exp, p.var);
+      if (d > 0) {
+        m = m * power(p.coeff, d);
+        has = true;
+      }
+    }
+    if (not has)
+      return;
+    toRemove.insert(c);
+    toAdd.insert(Constraint::get(expand(subs(c->exp * m, replace)), c->eq));
+  };
+  for (cc c : conju.ineqs)
+    replaced(c);
+  for (cc c : conju.eqs)
+    if (not linears.count(c))
+      replaced(c);
+  conju.removeJoin(toRemove, toAdd);
+  conju.removeUnused();
+  DEBUG(0, "System after the linear elimination:\n" << conju << NL);
+  return true;
 }
 
 bool Simplifier::gaussian_replacement(bool usePars) {
@@ -1756,7 +2038,7 @@ bool Simplifier::gaussian_replacement(bool usePars) {
       continue;
     }
 
-    SIGN qSign = tester->test(quoti).sign;
+    SIGN qSign = getTester()->test(quoti).sign;
     DEBUG(5, "Variable " << v << " has coefficient " << quoti << " {" << qSign
                          << "}\n");
     switch (qSign) {
@@ -2043,6 +2325,8 @@ void Simplifier::Motzkin() {
   Constraints remaining, zero, lb, ub;
   assert(conju.eqs.empty());
   gexmap<testResult> sign_cache;
+  // The branches are checked against this system, not the changed conju
+  SchweighoferTester *parent = getTester();
   for (cc c : conju.ineqs) {
     unsigned deg = degree(c->exp, target_here);
     if (deg == 0) {
@@ -2080,7 +2364,7 @@ void Simplifier::Motzkin() {
           break;
         }
       } else {
-        res = tester->test(q);
+        res = parent->test(q);
         sign_cache[q] = res;
       }
     }
@@ -2090,7 +2374,7 @@ void Simplifier::Motzkin() {
     switch (res.sign) {
     case SIGN::ABSURD: {
       DEBUG(0, "sign of " << q << " is an absurd\n";
-            tester->printResult(cerr, true););
+            getTester()->printResult(cerr, true););
       returnAbsurd();
       return;
     }
@@ -2113,7 +2397,7 @@ void Simplifier::Motzkin() {
       clear();
       exit(0);
 #else
-      ret.push_back(ns);
+      branch(parent, ns, q - 1);
       return;
 #endif
     } break;
@@ -2128,8 +2412,8 @@ void Simplifier::Motzkin() {
       clear();
       exit(0);
 #else
-      ret.push_back(ns);
-      ret.push_back(ns3);
+      branch(parent, ns, q - 1);
+      branch(parent, ns3, -q - 1);
       return;
 #endif
     } break;
@@ -2143,7 +2427,7 @@ void Simplifier::Motzkin() {
       clear();
       exit(0);
 #else
-      ret.push_back(ns2);
+      branch(parent, ns2, -q - 1);
       return;
 #endif
     } break;
@@ -2164,46 +2448,133 @@ void Simplifier::Motzkin() {
     unsigned deg = degree(c->exp, target_here);
     upperBounds[deg - 1].insert(c);
   }
+  /* In a linear elimination, with numeric coefficients, a combination derived
+   * from more than eliminated + 1 constraints is redundant (Chernikov), and so
+   * is one whose history includes the history of another (Imbert). Neither
+   * rule holds once a non linear elimination mixed the constraints, so the
+   * histories are reset then. */
+  bool linear = zero.empty() and target_here.is_equal(target);
+  for (const Constraints *bs : {&lb, &ub})
+    for (cc c : *bs)
+      linear = linear and (degree(c->exp, target_here) == 1) and
+               is_a<numeric>(quo(c->exp, target_here, target_here));
+  if (not linear) {
+    history.clear();
+    eliminated = 0;
+  }
+  gexmap<ConstraintSet> derived;
+  size_t combinations = 0, chernikov = 0;
   exset newConstraints;
   newConstraints.insert(1);
   unsigned newMaxDegree = 0;
   //  const ex powerRemoval = GiNaC::pow(2 * 3 * 5 * 7 * 9 * 11 * 13 * 17 * 19 *
   //  23, 4);
-  for (cMap::const_iterator lbIt = lowerBounds.begin();
-       lbIt != lowerBounds.end(); lbIt++) {
-    for (cc lb : lbIt->second) {
-      const ex loCoeff = quo(lb->exp, target_here, target_here);
-      const ex loRemai = rem(lb->exp, target_here, target_here);
-      for (cMap::const_iterator ubIt = upperBounds.begin();
-           ubIt != upperBounds.end(); ubIt++) {
-        for (cc ub : ubIt->second) {
-          const ex upCoeff = quo(ub->exp, target_here, target_here);
-          const ex upRemai = rem(ub->exp, target_here, target_here);
-          ex newCstr = 0;
-          newCstr = expand(loCoeff * upRemai - upCoeff * loRemai);
-          newMaxDegree = std::max((unsigned)(abs(degree(newCstr, target_here))),
-                                  newMaxDegree);
-          DEBUG(3, "We have that:\n"
-                       << "\tlower bound:" << lb
-                       << " | written as: " << target_here << GE << '('
-                       << expand(-loRemai) << ") / (" << loCoeff << ")\n"
-                       << "\tupper bound:" << ub
-                       << " | written as: " << target_here << LE << '('
-                       << expand(-upRemai) << ") / (" << upCoeff << ")\n"
-                       << "\tgiving: " << newCstr << GE << 0 << NL);
-          if (is_a<numeric>(newCstr)) {
-            if (newCstr < 0) {
-              DEBUG(3, "Which is an absurd constraint, returning false!\n");
-              _returnAbsurd();
-              return;
-            } else
-              continue;
-          }
-          newConstraints.insert(newCstr);
+  // Each bound written as coeff * target + remain, once
+  struct Bound {
+    cc c;
+    ex coeff, remain;
+  };
+  vector<Bound> los, ups;
+  for (const auto &bs : lowerBounds)
+    for (cc c : bs.second)
+      los.push_back({c, quo(c->exp, target_here, target_here),
+                     rem(c->exp, target_here, target_here)});
+  for (const auto &bs : upperBounds)
+    for (cc c : bs.second)
+      ups.push_back({c, quo(c->exp, target_here, target_here),
+                     rem(c->exp, target_here, target_here)});
+  auto combine = [&los, &ups](size_t l, size_t u) {
+    return expand(los[l].coeff * ups[u].remain - ups[u].coeff * los[l].remain);
+  };
+  /* The combinations of a lower bound with every upper bound make a tile.
+   * With more than one job, and enough pairs, the tiles are expanded upfront
+   * by the workers and sent back printed; otherwise each pair is expanded
+   * when consumed. Either way they are consumed in the same order. */
+  vector<vector<ex>> tiles(los.size());
+  if ((parallel::jobs > 1) and (los.size() > 1) and
+      (los.size() * ups.size() >= PARALLEL_PAIRS)) {
+    vector<string> res = parallel::map(los.size(), [&](size_t l) {
+      stringstream ss;
+      for (size_t u = 0; u < ups.size(); u++)
+        ss << combine(l, u) << NL;
+      return ss.str();
+    });
+    parser reader(Constraint::SymTab);
+    for (size_t l = 0; l < los.size(); l++) {
+      stringstream ss(res[l]);
+      for (string line; getline(ss, line);)
+        tiles[l].push_back(reader(line));
+      assert(tiles[l].size() == ups.size());
+    }
+    stats::add("motzkin.parallel_pairs", los.size() * ups.size());
+  }
+
+  for (size_t l = 0; l < los.size(); l++) {
+    cc lo = los[l].c;
+    for (size_t u = 0; u < ups.size(); u++) {
+      cc up = ups[u].c;
+      const ex newCstr = tiles[l].empty() ? combine(l, u) : tiles[l][u];
+      newMaxDegree = std::max((unsigned)(abs(degree(newCstr, target_here))),
+                              newMaxDegree);
+      DEBUG(3, "We have that:\n"
+                   << "\tlower bound:" << lo << " | written as: " << target_here
+                   << GE << '(' << expand(-los[l].remain) << ") / ("
+                   << los[l].coeff << ")\n"
+                   << "\tupper bound:" << up << " | written as: " << target_here
+                   << LE << '(' << expand(-ups[u].remain) << ") / ("
+                   << ups[u].coeff << ")\n"
+                   << "\tgiving: " << newCstr << GE << 0 << NL);
+      if (is_a<numeric>(newCstr)) {
+        if (newCstr < 0) {
+          DEBUG(3, "Which is an absurd constraint, returning false!\n");
+          _returnAbsurd();
+          return;
+        } else
+          continue;
+      }
+      combinations++;
+      if (linear) {
+        const ConstraintSet h = historyOf(lo) | historyOf(up);
+        if (h.size() > eliminated + 2) {
+          DEBUG(5, "Chernikov: " << newCstr << " is redundant\n");
+          chernikov++;
+          continue;
         }
+        auto d = derived.find(newCstr);
+        if (d == derived.end())
+          derived.insert({newCstr, h});
+        else if (h.size() < d->second.size())
+          d->second = h;
       }
+      newConstraints.insert(newCstr);
     }
   }
+  size_t imbert = 0;
+  if (linear) {
+    for (auto i = derived.begin(); i != derived.end(); i++)
+      for (const auto &j : derived)
+        if ((i->second.size() > j.second.size()) and
+            i->second.includes(j.second)) {
+          DEBUG(5, "Imbert: " << i->first << " is redundant\n");
+          newConstraints.erase(i->first);
+          imbert++;
+          break;
+        }
+    for (const auto &d : derived)
+      if (newConstraints.count(d.first)) {
+        cc c = Constraint::get(d.first);
+        auto h = history.find(c);
+        if ((h == history.end()) or (d.second.size() < h->second.size()))
+          history[c] = d.second;
+      }
+    eliminated++;
+  }
+  DEBUG(1, "Eliminating " << target_here << " generated " << combinations
+                          << " combinations, pruned " << chernikov
+                          << " by Chernikov and " << imbert << " by Imbert\n");
+  stats::add("motzkin.combinations", combinations);
+  stats::add("motzkin.pruned.chernikov", chernikov);
+  stats::add("motzkin.pruned.imbert", imbert);
   if (zero.size() > 0) {
     exset nc;
     Constraints nr;
@@ -2230,10 +2601,8 @@ void Simplifier::Motzkin() {
       remaining.insert(Constraint::get(constraint));
     }
 
-    Symbols vars;
-    for (const ex &s : conju.vars)
-      if (s != target_here)
-        vars.append(s);
+    Symbols vars = conju.vars;
+    vars.remove(target_here);
 
     DEBUG(6, "Variable " << target_here << " has been eliminated." << NL);
     targetDegree = 0;
@@ -2280,6 +2649,44 @@ void Simplifier::Motzkin() {
 }
 
 void Simplifier::selectTarget() {
+  if ((planner::strategy == planner::GREEDY) or (conju.vars.nops() < 2)) {
+    selectGreedy();
+    return;
+  }
+  vector<planner::Row> rows;
+  // The bounds only refine the costs, they are not worth building a tester
+  const IntegerBox none;
+  const IntegerBox &box = tester ? tester->getBox() : none;
+  for (cc c : conju.ineqs)
+    rows.push_back(planner::row(c->exp, conju.vars, box));
+  const vector<ex> vars(conju.vars.begin(), conju.vars.end());
+  target = planner::select(
+      rows, vars,
+      planner::strategy == planner::LOOKAHEAD ? planner::depth : 1);
+  targetDegree = targetDegreeOf(target);
+}
+
+unsigned Simplifier::degreeWith(const ex &e, const ex &s, ex &q) const {
+  q = quo(e, s, s);
+  if (q.is_zero())
+    return 0;
+  unsigned dg = (unsigned)(abs(e.degree(s)));
+  for (const ex &v : conju.vars)
+    if (s != v)
+      dg += (unsigned)(abs(q.degree(v)));
+  return dg;
+}
+
+unsigned Simplifier::targetDegreeOf(const ex &s) const {
+  unsigned d = 0;
+  for (const cc c : conju.ineqs) {
+    ex q;
+    d = std::max(d, degreeWith(c->exp, s, q));
+  }
+  return d;
+}
+
+void Simplifier::selectGreedy() {
   ex variable;
   unsigned numExps = 99999, nonNum = 99999;
   unsigned degree = 99999;
@@ -2288,18 +2695,12 @@ void Simplifier::selectTarget() {
     bool newVar = true;
     unsigned varDegree = 0, exps = 0, nonNumeric = 0;
     for (const cc c : conju.ineqs) {
-      ex q = quo(c->exp, s, s);
+      ex q;
+      const unsigned dg = degreeWith(c->exp, s, q);
       if (q.is_zero()) {
         continue;
       }
       exps++;
-      unsigned dg = (unsigned)(abs(c->exp.degree(s)));
-      for (const ex &e : conju.vars) {
-        if (s == e)
-          continue;
-
-        dg += (unsigned)(abs(q.degree(e)));
-      }
       varDegree = std::max(varDegree, dg);
 
       if (varDegree >= degree) {
@@ -21,6 +21,7 @@
 //#include "Constraint.hpp"
 #include "Disjunction.hpp"
 #include "Schweighofer.hpp"
+#include <functional>
 
 // class Conjunction;
 
@@ -32,6 +33,13 @@ public:
   ~Simplifier();
   Conjs get() { return ret; }
   void run();
+  /* Eliminates on its own each component of the constraints connected by
+   * shared variables, with the constraints free of variables, giving in ret
+   * the simplified cross product of their results. Returns false if there are
+   * less than two components. */
+  bool decompose();
+  // Depth of the runs of decompose, whose results are not the whole answer
+  static unsigned nesting;
 
   bool add_affine_planes();
   bool tightening();
@@ -40,9 +48,12 @@ public:
   bool getRoots();
   bool normalize();
   bool gaussian_replacement() {
-    return gaussian_replacement(false) | gaussian_replacement(true);
+    return linear_elimination() | gaussian_replacement(false) |
+           gaussian_replacement(true);
   }
   bool gaussian_replacement(bool usePars);
+  // Eliminates at once the variables of the linear equalities
+  bool linear_elimination();
   void clear();
   bool eqs_pattern_matching();
   bool eqs_affinize();
@@ -55,11 +66,65 @@ private:
   };
   ex target;
   unsigned targetDegree = 0;
-  void build_tester();
+  /* Chernikov/Imbert histories: the constraints each one was derived from,
+   * by the linear eliminations done since the last non linear one, and how
+   * many variables these eliminated. A constraint without history is its
+   * own. */
+  map<cc, ConstraintSet> history;
+  unsigned eliminated = 0;
+  ConstraintSet historyOf(cc c) const {
+    auto it = history.find(c);
+    return it == history.end() ? ConstraintSet({c}) : it->second;
+  }
+  /* A pass queries the tester of conju as it was when the pass first asked
+   * for it, even if the pass changes conju meanwhile. reset_tester ends the
+   * pass; the next query gets the tester of conju, that is only rebuilt if
+   * conju changed. */
+  SchweighoferTester *getTester() {
+    if (tester == nullptr)
+      tester = conju.shareTester();
+    return tester.get();
+  }
+  void reset_tester() { tester.reset(); }
+
+  /* Change log driven scheduling of the passes. A pass only looks at the
+   * constraints that are new since it last ran without changing the system,
+   * and at those sharing symbols with them; it is skipped if there are
+   * none. A pass runs over the whole system once the variables changed, as
+   * tightening does not drop the same constraints with and without them. */
+  enum Pass {
+    AFFINIZE,
+    PATTERN,
+    GAUSSIAN,
+    PLANES,
+    ROOTS,
+    NORMALIZE,
+    TIGHTENING,
+    NPASSES
+  };
+  bool pass(Pass p, const function<bool()> &run);
+  // Should the running pass look at c
+  bool inFocus(cc c) const { return (not focused) or focus.count(c); }
+  ConstraintSet seen[NPASSES]; // The system after the last run without change
+  Symbols seenVars[NPASSES];    // Its variables
+  ConstraintSet focus;
+  bool focused = false;
   ex compose(const testResult tr, const ex &tested);
+  /* Queue child, the system joined with added >= 0, unless it is proven
+   * empty by the bounds of the parent IntegerBox, or by the parent tester
+   * implying -added - 1 >= 0. parent is the tester of the system before the
+   * split, taken before conju is changed. */
+  void branch(SchweighoferTester *parent, const Conjunction &child,
+              const ex &added);
   bool proved(const testResult tr) const;
   //    bool precision_increase();
   void selectTarget();
+  void selectGreedy();
+  /* Degree of s in e, plus the degree in the other variables of q, the
+   * quotient of e by s; zero if no term of e holds s */
+  unsigned degreeWith(const ex &e, const ex &s, ex &q) const;
+  // Max degree in the variables of the terms holding s, s included
+  unsigned targetDegreeOf(const ex &s) const;
   int not_lifting = 2;
   unsigned lifting_target_degree = 999;
 
@@ -80,7 +145,8 @@ private:
 
   Conjunction conju;
   Conjs ret;
-  SchweighoferTester *tester = nullptr;
+  // Shared with conju, and kept alive if conju discards it
+  std::shared_ptr<SchweighoferTester> tester;
 };
 
 #endif /* SIMPLIFIER_HPP_ */
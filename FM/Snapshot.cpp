@@ -0,0 +1,394 @@
+#include "Schweighofer.hpp"
+#include "Stats.hpp"
+#include "debug.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace GiNaC;
+
+/* Binary snapshot of an expanded SchweighoferTester. All values are stored in
+ * the host byte order, every section starts at a 8 bytes boundary:
+ *
+ *  Header
+ *  char     srcs[srcsSize]                 canonical sources (see canonical)
+ *  uint32_t symOffsets[nSymbols + 1]       symbol names, offsets in symNames
+ *  char     symNames[]
+ *  uint32_t termPtr[nRows + 1]             monomial of row r is the product
+ *  uint32_t terms[nTerms]                  of terms[termPtr[r-1]..termPtr[r]),
+ *                                          packed as symbol << 16 | exponent
+ *  uint32_t colPtr[nCols + 1]              CSC matrix of the LP; column c is
+ *  uint32_t rowIdx[nNonZeros]              the generator c, given exactly by
+ *  double   vals[nNonZeros]                the num / den coefficients of its
+ *  int64_t  num[nNonZeros]                 monomials
+ *  int64_t  den[nNonZeros]
+ *  uint8_t  rowStat[nRows], colStat[nCols] last basis, if hasBasis
+ */
+namespace {
+const char MAGIC[8] = {'P', 'F', 'M', 'E', 'T', 'S', 'T', '\0'};
+const uint32_t VERSION = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version, degree;
+  uint64_t key, size;
+  uint32_t srcsSize, nSymbols, nRows, nTerms, nCols, nNonZeros, hasBasis, pad;
+};
+
+struct Writer {
+  vector<char> buf;
+  template <typename T> void put(const T *v, size_t n) {
+    buf.resize((buf.size() + 7) & ~size_t(7), 0);
+    const char *p = reinterpret_cast<const char *>(v);
+    buf.insert(buf.end(), p, p + n * sizeof(T));
+  }
+};
+
+struct Reader {
+  const char *base;
+  size_t size, pos = 0;
+  Reader(const void *b, size_t s)
+      : base(static_cast<const char *>(b)), size(s) {}
+  // Returns nullptr if the file is too short
+  template <typename T> const T *take(size_t n) {
+    pos = (pos + 7) & ~size_t(7);
+    if ((pos > size) or (n * sizeof(T) > size - pos))
+      return nullptr;
+    const T *r = reinterpret_cast<const T *>(base + pos);
+    pos += n * sizeof(T);
+    return r;
+  }
+};
+
+uint64_t fnv1a(const string &s) {
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+bool toInt64(const numeric &n, int64_t &v) {
+  static const numeric lim(numeric_limits<long>::max());
+  if ((not n.is_integer()) or (abs(n) > lim))
+    return false;
+  v = n.to_long();
+  return true;
+}
+
+// Exact version of SchweighoferTester::gatherMonomials
+void exactMonomials(const ex &e, gexmap<numeric> &coeffs) {
+  if (is_a<add>(e)) {
+    for (const ex &op : e)
+      exactMonomials(op, coeffs);
+    return;
+  }
+  if (is_a<numeric>(e)) {
+    coeffs[1] += ex_to<numeric>(e);
+    return;
+  }
+  numeric c = 1;
+  if (is_a<mul>(e))
+    for (const ex &op : e)
+      if (is_a<numeric>(op))
+        c = ex_to<numeric>(op);
+  coeffs[e / c] += c;
+}
+
+// Packs a monomial as symbol << 16 | exponent terms
+bool pack(const ex &m, map<string, uint32_t> &symIdx, vector<uint32_t> &terms) {
+  auto term = [&](const ex &f) {
+    ex b = f;
+    numeric d = 1;
+    if (is_a<power>(f)) {
+      b = f.op(0);
+      if (not is_a<numeric>(f.op(1)))
+        return false;
+      d = ex_to<numeric>(f.op(1));
+    }
+    if ((not is_a<symbol>(b)) or (not d.is_pos_integer()) or (d > 0xFFFF))
+      return false;
+    auto s = symIdx.insert({ex_to<symbol>(b).get_name(), symIdx.size()});
+    if (s.first->second > 0xFFFF)
+      return false;
+    terms.push_back((s.first->second << 16) | d.to_int());
+    return true;
+  };
+  if (is_a<numeric>(m))
+    return m.is_equal(1);
+  if (not is_a<mul>(m))
+    return term(m);
+  for (const ex &f : m)
+    if (not term(f))
+      return false;
+  return true;
+}
+} // namespace
+
+string SchweighoferTester::snapshotDir = "";
+
+/* The sources, printed and sorted, and the options that change the expansion.
+ * Printing only depends on the symbol names, so it is the same in any
+ * process. */
+static string canonical(const exset &srcs, unsigned degree) {
+  vector<string> lines;
+  for (const ex &e : srcs) {
+    stringstream ss;
+    ss << e;
+    lines.push_back(ss.str());
+  }
+  sort(lines.begin(), lines.end());
+  stringstream ss;
+  ss << "degree " << degree << " squares " << SchweighoferTester::squareGenerators
+     << '\n';
+  for (const string &l : lines)
+    ss << l << '\n';
+  return ss.str();
+}
+
+bool SchweighoferTester::loadSnapshot(const exset &srcs) {
+  if (snapshotDir.empty())
+    return false;
+  snapshotSrcs = canonical(srcs, MAX_ORDER);
+  const uint64_t key = fnv1a(snapshotSrcs);
+  stringstream path;
+  path << snapshotDir << '/' << hex << key << ".pst";
+  snapshotPath = path.str();
+
+  int fd = open(snapshotPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if ((fstat(fd, &st) != 0) or (size_t(st.st_size) < sizeof(Header))) {
+    close(fd);
+    return false;
+  }
+  const size_t size = st.st_size;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  bool ok = false;
+  Reader r(map, size);
+  const Header *h = r.take<Header>(1);
+  const char *srcsText = nullptr;
+  if (h and (0 == memcmp(h->magic, MAGIC, sizeof(MAGIC))) and
+      (h->version == VERSION) and (h->degree == MAX_ORDER) and
+      (h->key == key) and (h->size == size) and
+      (h->srcsSize == snapshotSrcs.size()) and
+      (srcsText = r.take<char>(h->srcsSize)) and
+      (0 == memcmp(srcsText, snapshotSrcs.data(), h->srcsSize))) {
+    const uint32_t *symOffsets = r.take<uint32_t>(h->nSymbols + 1);
+    const char *symNames =
+        symOffsets ? r.take<char>(symOffsets[h->nSymbols]) : nullptr;
+    const uint32_t *termPtr = r.take<uint32_t>(h->nRows + 1);
+    const uint32_t *terms = r.take<uint32_t>(h->nTerms);
+    const uint32_t *colPtr = r.take<uint32_t>(h->nCols + 1);
+    const uint32_t *rowIdx = r.take<uint32_t>(h->nNonZeros);
+    const double *vals = r.take<double>(h->nNonZeros);
+    const int64_t *num = r.take<int64_t>(h->nNonZeros);
+    const int64_t *den = r.take<int64_t>(h->nNonZeros);
+    const uint8_t *rowStat = h->hasBasis ? r.take<uint8_t>(h->nRows) : nullptr;
+    const uint8_t *colStat = h->hasBasis ? r.take<uint8_t>(h->nCols) : nullptr;
+    ok = symNames and termPtr and terms and colPtr and rowIdx and vals and
+         num and den and ((not h->hasBasis) or (rowStat and colStat)) and
+         (termPtr[h->nRows] == h->nTerms) and
+         (colPtr[h->nCols] == h->nNonZeros);
+    for (uint32_t i = 0; ok and (i < h->nSymbols); i++)
+      ok = symOffsets[i] < symOffsets[i + 1];
+    for (uint32_t i = 0; ok and (i < h->nRows); i++)
+      ok = termPtr[i] <= termPtr[i + 1];
+    for (uint32_t i = 0; ok and (i < h->nCols); i++)
+      ok = colPtr[i] <= colPtr[i + 1];
+    for (uint32_t i = 0; ok and (i < h->nNonZeros); i++)
+      ok = (rowIdx[i] >= 1) and (rowIdx[i] <= h->nRows) and (den[i] > 0);
+    for (uint32_t i = 0; ok and (i < h->nTerms); i++)
+      ok = (terms[i] >> 16) < h->nSymbols;
+
+    if (ok) {
+      vector<ex> symbs, monoms(h->nRows + 1);
+      for (uint32_t i = 0; i < h->nSymbols; i++)
+        symbs.push_back(Constraint::getOrInsertSymbol(
+            string(symNames + symOffsets[i], symOffsets[i + 1] - symOffsets[i])));
+      for (uint32_t row = 1; row <= h->nRows; row++) {
+        ex m = 1;
+        for (uint32_t t = termPtr[row - 1]; t < termPtr[row]; t++)
+          m *= pow(symbs[terms[t] >> 16], terms[t] & 0xFFFF);
+        monoms[row] = m;
+        monomPos[m] = row;
+      }
+
+      problem = glp_create_prob();
+      glp_add_cols(problem, h->nCols);
+      glp_add_rows(problem, h->nRows);
+      for (uint32_t row = 1; row <= h->nRows; row++) {
+        stringstream ss;
+        ss << monoms[row];
+        glp_set_row_name(problem, row, ss.str().c_str());
+      }
+      vector<int> ia = {0}, ja = {0};
+      vector<double> ar = {0};
+      for (uint32_t col = 1; col <= h->nCols; col++) {
+        ex g = 0;
+        for (uint32_t nz = colPtr[col - 1]; nz < colPtr[col]; nz++) {
+          g += numeric(num[nz]) / numeric(den[nz]) * monoms[rowIdx[nz]];
+          ia.push_back(rowIdx[nz]);
+          ja.push_back(col);
+          ar.push_back(vals[nz]);
+        }
+        ineqPos[g] = col;
+        glp_set_col_bnds(problem, col, GLP_LO, 0.0000, 0);
+        glp_set_obj_coef(problem, col, 0);
+      }
+      glp_load_matrix(problem, h->nNonZeros, ia.data(), ja.data(), ar.data());
+      glp_set_obj_dir(problem, GLP_MAX);
+      glp_set_obj_coef(problem, 1, 1);
+      if (h->hasBasis) {
+        for (uint32_t row = 1; row <= h->nRows; row++)
+          glp_set_row_stat(problem, row, rowStat[row - 1]);
+        for (uint32_t col = 1; col <= h->nCols; col++)
+          glp_set_col_stat(problem, col, colStat[col - 1]);
+      }
+      ok = (monomPos.size() == h->nRows) and (ineqPos.size() == h->nCols);
+      if (not ok) {
+        glp_delete_prob(problem);
+        problem = nullptr;
+      }
+    }
+  }
+  munmap(map, size);
+  if (not ok) {
+    DEBUG(3, "Ignoring bad tester snapshot " << snapshotPath << NL);
+    monomPos.clear();
+    ineqPos.clear();
+    return false;
+  }
+  DEBUG(4, "Loaded tester snapshot " << snapshotPath << NL);
+  stats::add("tester.snapshot_loads");
+  snapshotPath.clear(); // Nothing new to save
+  return true;
+}
+
+void SchweighoferTester::saveSnapshot() const {
+  if (snapshotPath.empty() or (problem == nullptr))
+    return;
+
+  map<string, uint32_t> symIdx;
+  vector<uint32_t> termPtr(monomPos.size() + 1, 0), terms;
+  vector<vector<uint32_t>> rowTerms(monomPos.size() + 1);
+  for (const auto &m : monomPos) {
+    if ((m.second < 1) or (size_t(m.second) > monomPos.size()) or
+        (not pack(m.first, symIdx, rowTerms[m.second]))) {
+      DEBUG(3, "Can't save snapshot with monomial " << m.first << NL);
+      return;
+    }
+  }
+  for (size_t row = 1; row < rowTerms.size(); row++) {
+    terms.insert(terms.end(), rowTerms[row].begin(), rowTerms[row].end());
+    termPtr[row] = terms.size();
+  }
+
+  const int nCols = glp_get_num_cols(problem), nRows = glp_get_num_rows(problem);
+  if ((size_t(nCols) != ineqPos.size()) or (size_t(nRows) != monomPos.size()))
+    return;
+  vector<ex> gens(nCols + 1);
+  for (const auto &g : ineqPos)
+    gens[g.second] = g.first;
+
+  vector<uint32_t> colPtr = {0}, rowIdx;
+  vector<double> vals;
+  vector<int64_t> num, den;
+  for (int col = 1; col <= nCols; col++) {
+    gexmap<numeric> coeffs;
+    exactMonomials(gens[col], coeffs);
+    for (const auto &c : coeffs) {
+      if (c.second.is_zero())
+        continue;
+      auto row = monomPos.find(c.first);
+      int64_t n, d;
+      if ((row == monomPos.end()) or (not toInt64(c.second.numer(), n)) or
+          (not toInt64(c.second.denom(), d))) {
+        DEBUG(3, "Can't save snapshot with generator " << gens[col] << NL);
+        return;
+      }
+      rowIdx.push_back(row->second);
+      vals.push_back(c.second.to_double());
+      num.push_back(n);
+      den.push_back(d);
+    }
+    colPtr.push_back(rowIdx.size());
+  }
+
+  vector<uint32_t> symOffsets(symIdx.size() + 1, 0);
+  vector<string> names(symIdx.size());
+  for (const auto &s : symIdx)
+    names[s.second] = s.first;
+  string symNames;
+  for (size_t i = 0; i < names.size(); i++) {
+    symNames += names[i];
+    symOffsets[i + 1] = symNames.size();
+  }
+
+  vector<uint8_t> rowStat(nRows), colStat(nCols);
+  for (int row = 1; row <= nRows; row++)
+    rowStat[row - 1] = glp_get_row_stat(problem, row);
+  for (int col = 1; col <= nCols; col++)
+    colStat[col - 1] = glp_get_col_stat(problem, col);
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = VERSION;
+  h.degree = MAX_ORDER;
+  h.key = fnv1a(snapshotSrcs);
+  h.srcsSize = snapshotSrcs.size();
+  h.nSymbols = names.size();
+  h.nRows = nRows;
+  h.nTerms = terms.size();
+  h.nCols = nCols;
+  h.nNonZeros = rowIdx.size();
+  h.hasBasis = glp_get_status(problem) != GLP_UNDEF;
+
+  Writer w;
+  w.put(&h, 1);
+  w.put(snapshotSrcs.data(), snapshotSrcs.size());
+  w.put(symOffsets.data(), symOffsets.size());
+  w.put(symNames.data(), symNames.size());
+  w.put(termPtr.data(), termPtr.size());
+  w.put(terms.data(), terms.size());
+  w.put(colPtr.data(), colPtr.size());
+  w.put(rowIdx.data(), rowIdx.size());
+  w.put(vals.data(), vals.size());
+  w.put(num.data(), num.size());
+  w.put(den.data(), den.size());
+  if (h.hasBasis) {
+    w.put(rowStat.data(), rowStat.size());
+    w.put(colStat.data(), colStat.size());
+  }
+  reinterpret_cast<Header *>(w.buf.data())->size = w.buf.size();
+
+  // Write aside and rename, so concurrent processes never see half a file
+  stringstream tmp;
+  tmp << snapshotPath << ".tmp." << getpid();
+  FILE *f = fopen(tmp.str().c_str(), "wb");
+  if (f == nullptr) {
+    DEBUG(3, "Can't write tester snapshot " << tmp.str() << NL);
+    return;
+  }
+  bool written = fwrite(w.buf.data(), 1, w.buf.size(), f) == w.buf.size();
+  written &= 0 == fclose(f);
+  if (written and (0 == rename(tmp.str().c_str(), snapshotPath.c_str()))) {
+    DEBUG(4, "Saved tester snapshot " << snapshotPath << NL);
+    stats::add("tester.snapshot_saves");
+  } else
+    remove(tmp.str().c_str());
+}
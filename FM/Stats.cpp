@@ -0,0 +1,34 @@
+#include "Stats.hpp"
+#include <iomanip>
+
+namespace stats {
+bool enabled = false;
+
+static map<string, unsigned long long> &counters() {
+  static map<string, unsigned long long> c;
+  return c;
+}
+
+void add(const string &counter, unsigned long long by) {
+  if (enabled)
+    counters()[counter] += by;
+}
+
+unsigned long long get(const string &counter) {
+  auto it = counters().find(counter);
+  return it == counters().end() ? 0 : it->second;
+}
+
+const map<string, unsigned long long> &all() { return counters(); }
+
+ostream &print(ostream &out) {
+  size_t width = 0;
+  for (const auto &c : counters())
+    width = max(width, c.first.size());
+  out << "Statistics:\n";
+  for (const auto &c : counters())
+    out << "  " << left << setw(width) << c.first << right << " = " << c.second
+        << '\n';
+  return out;
+}
+} // namespace stats
@@ -0,0 +1,23 @@
+#pragma once
+#ifndef _STATS_HPP_
+#define _STATS_HPP_
+
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace std;
+
+/* Named counters of the work done by the simplifier, such as the number of
+ * branches created or the size of the testers LP. They are only gathered when
+ * enabled, by the -s option, and printed to cerr at the end of the run. */
+namespace stats {
+extern bool enabled;
+
+void add(const string &counter, unsigned long long by = 1);
+unsigned long long get(const string &counter);
+const map<string, unsigned long long> &all();
+ostream &print(ostream &out);
+} // namespace stats
+
+#endif //_STATS_HPP_
@@ -0,0 +1,151 @@
+#include "Symbols.hpp"
+#include "debug.hpp"
+#include <deque>
+#include <map>
+
+using namespace std;
+using namespace GiNaC;
+
+namespace {
+// A deque, so references to the symbols stay valid as new ones come
+deque<ex> &byIndex() {
+  static deque<ex> symbols;
+  return symbols;
+}
+
+map<ex, size_t, ex_is_less> &indexes() {
+  static map<ex, size_t, ex_is_less> idx;
+  return idx;
+}
+} // namespace
+
+size_t Symbols::indexOf(const ex &s) {
+  assertM(is_a<symbol>(s), s << " is not a symbol\n");
+  auto it = indexes().find(s);
+  if (it != indexes().end())
+    return it->second;
+  byIndex().push_back(s);
+  return indexes().insert({s, byIndex().size() - 1}).first->second;
+}
+
+const ex &Symbols::fromIndex(size_t idx) {
+  assert(idx < byIndex().size());
+  return byIndex()[idx];
+}
+
+Symbols Symbols::of(const ex &e) {
+  Symbols r;
+  for (ex::const_preorder_iterator i = e.preorder_begin(),
+                                   iEnd = e.preorder_end();
+       i != iEnd; ++i)
+    if (is_a<symbol>(*i))
+      r.append(*i);
+  return r;
+}
+
+size_t Symbols::nops() const {
+  size_t n = 0;
+  for (uint64_t w : words)
+    n += __builtin_popcountll(w);
+  return n;
+}
+
+bool Symbols::has(const ex &s) const {
+  if (not is_a<symbol>(s))
+    return false;
+  auto it = indexes().find(s);
+  if (it == indexes().end())
+    return false;
+  const size_t i = it->second;
+  return (i / 64 < words.size()) and ((words[i / 64] >> (i % 64)) & 1);
+}
+
+Symbols &Symbols::append(const ex &s) {
+  const size_t i = indexOf(s);
+  if (i / 64 >= words.size())
+    words.resize(i / 64 + 1, 0);
+  words[i / 64] |= uint64_t(1) << (i % 64);
+  return *this;
+}
+
+Symbols &Symbols::remove(const ex &s) {
+  if (not has(s))
+    return *this;
+  const size_t i = indexOf(s);
+  words[i / 64] &= ~(uint64_t(1) << (i % 64));
+  trim();
+  return *this;
+}
+
+Symbols &Symbols::operator|=(const Symbols &o) {
+  if (o.words.size() > words.size())
+    words.resize(o.words.size(), 0);
+  for (size_t w = 0; w < o.words.size(); w++)
+    words[w] |= o.words[w];
+  return *this;
+}
+
+Symbols &Symbols::operator&=(const Symbols &o) {
+  if (words.size() > o.words.size())
+    words.resize(o.words.size());
+  for (size_t w = 0; w < words.size(); w++)
+    words[w] &= o.words[w];
+  trim();
+  return *this;
+}
+
+Symbols &Symbols::operator-=(const Symbols &o) {
+  for (size_t w = 0; w < min(words.size(), o.words.size()); w++)
+    words[w] &= ~o.words[w];
+  trim();
+  return *this;
+}
+
+bool Symbols::includes(const Symbols &o) const {
+  if (o.words.size() > words.size())
+    return false;
+  for (size_t w = 0; w < o.words.size(); w++)
+    if (o.words[w] & ~words[w])
+      return false;
+  return true;
+}
+
+bool Symbols::intersects(const Symbols &o) const {
+  for (size_t w = 0; w < min(words.size(), o.words.size()); w++)
+    if (words[w] & o.words[w])
+      return true;
+  return false;
+}
+
+uint64_t Symbols::hash() const {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (uint64_t w : words)
+    h = (h ^ w) * 0x100000001b3ULL;
+  return h;
+}
+
+size_t Symbols::next(size_t from) const {
+  for (size_t w = from / 64; w < words.size(); w++) {
+    uint64_t bits = words[w];
+    if (w == from / 64)
+      bits &= ~uint64_t(0) << (from % 64);
+    if (bits)
+      return w * 64 + __builtin_ctzll(bits);
+  }
+  return NONE;
+}
+
+void Symbols::trim() {
+  while ((not words.empty()) and (words.back() == 0))
+    words.pop_back();
+}
+
+ostream &operator<<(ostream &out, const Symbols &s) {
+  out << '{';
+  string bef = "";
+  for (const ex &x : s) {
+    out << bef << x;
+    bef = ",";
+  }
+  return out << '}';
+}
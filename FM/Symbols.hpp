@@ -0,0 +1,93 @@
+#pragma once
+#ifndef _SYMBOLS_HPP_
+#define _SYMBOLS_HPP_
+
+#include <cstdint>
+#include <ginac/ginac.h>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+/* Set of symbols stored as a bitmask over a dense index, that every symbol
+ * gets the first time it is seen. Membership, union, intersection and
+ * inclusion are word operations, a single one while we have less than 64
+ * symbols.
+ *
+ * It offers the part of the GiNaC::lst interface we use for the variables and
+ * parameters of a system, and iterates in index order, that is, in the order
+ * the symbols were first seen. */
+class Symbols {
+public:
+  class const_iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef GiNaC::ex value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const GiNaC::ex *pointer;
+    typedef const GiNaC::ex &reference;
+
+    const_iterator() {}
+    const_iterator(const Symbols *s, size_t i) : set(s), idx(i) {}
+    const GiNaC::ex &operator*() const { return fromIndex(idx); }
+    const GiNaC::ex *operator->() const { return &fromIndex(idx); }
+    const_iterator &operator++() {
+      idx = set->next(idx + 1);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator r = *this;
+      ++*this;
+      return r;
+    }
+    bool operator==(const const_iterator &o) const { return idx == o.idx; }
+    bool operator!=(const const_iterator &o) const { return idx != o.idx; }
+
+  private:
+    const Symbols *set = nullptr;
+    size_t idx = NONE;
+  };
+  typedef const_iterator iterator;
+
+  Symbols() {}
+  // The symbols occurring in e
+  static Symbols of(const GiNaC::ex &e);
+  // The index of symbol s, given to it on its first request
+  static size_t indexOf(const GiNaC::ex &s);
+  static const GiNaC::ex &fromIndex(size_t idx);
+
+  const_iterator begin() const { return const_iterator(this, next(0)); }
+  const_iterator end() const { return const_iterator(this, NONE); }
+  size_t nops() const;
+  bool empty() const { return words.empty(); }
+
+  bool has(const GiNaC::ex &s) const;
+  Symbols &append(const GiNaC::ex &s);
+  Symbols &remove(const GiNaC::ex &s);
+  void remove_all() { words.clear(); }
+
+  Symbols operator|(const Symbols &o) const { return Symbols(*this) |= o; }
+  Symbols operator&(const Symbols &o) const { return Symbols(*this) &= o; }
+  Symbols operator-(const Symbols &o) const { return Symbols(*this) -= o; }
+  Symbols &operator|=(const Symbols &o);
+  Symbols &operator&=(const Symbols &o);
+  Symbols &operator-=(const Symbols &o); // AND NOT
+  bool includes(const Symbols &o) const; // o is a subset of this
+  bool intersects(const Symbols &o) const;
+
+  bool operator==(const Symbols &o) const { return words == o.words; }
+  bool operator!=(const Symbols &o) const { return words != o.words; }
+  uint64_t hash() const;
+
+private:
+  static const size_t NONE = SIZE_MAX;
+  // First index >= from holding a symbol, or NONE
+  size_t next(size_t from) const;
+  // Drop the zero words at the end, so equal sets have equal words
+  void trim();
+
+  std::vector<uint64_t> words;
+};
+
+std::ostream &operator<<(std::ostream &out, const Symbols &s);
+
+#endif //_SYMBOLS_HPP_
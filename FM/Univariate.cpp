@@ -0,0 +1,369 @@
+#include "Univariate.hpp"
+#include "debug.hpp"
+
+using namespace std;
+using namespace GiNaC;
+
+static numeric floorq(const numeric &q) {
+  const numeric n = q.numer(), d = q.denom();
+  numeric r = iquo(n, d);
+  if (n.is_negative() and not irem(n, d).is_zero())
+    r = r - 1;
+  return r;
+}
+
+static numeric ceilq(const numeric &q) { return -floorq(-q); }
+
+bool Interval::tightenLo(const numeric &l) {
+  if (hasLo and (l <= lo))
+    return false;
+  hasLo = true;
+  lo = l;
+  return true;
+}
+
+bool Interval::tightenHi(const numeric &h) {
+  if (hasHi and (h >= hi))
+    return false;
+  hasHi = true;
+  hi = h;
+  return true;
+}
+
+IntegerBox::IntegerBox(const exset &ineqs, unsigned rounds) {
+  for (const ex &e : ineqs)
+    insert(e);
+  propagate(rounds);
+}
+
+bool IntegerBox::linear(const ex &e, gexmap<numeric> &coeffs, numeric &cst) {
+  cst = 0;
+  auto term = [&](const ex &t) {
+    if (is_a<numeric>(t)) {
+      if (not ex_to<numeric>(t).is_rational())
+        return false;
+      cst += ex_to<numeric>(t);
+      return true;
+    }
+    if (is_a<symbol>(t)) {
+      coeffs[t] += 1;
+      return true;
+    }
+    if (not is_a<mul>(t))
+      return false;
+    numeric c = 1;
+    ex s = 0;
+    for (const ex &op : t) {
+      if (is_a<numeric>(op) and ex_to<numeric>(op).is_rational())
+        c *= ex_to<numeric>(op);
+      else if (is_a<symbol>(op) and s.is_zero())
+        s = op;
+      else
+        return false;
+    }
+    if (s.is_zero())
+      return false;
+    coeffs[s] += c;
+    return true;
+  };
+  if (is_a<add>(e)) {
+    for (const ex &op : e)
+      if (not term(op))
+        return false;
+    return true;
+  }
+  return term(e);
+}
+
+bool IntegerBox::insert(const ex &ineq) {
+  gexmap<numeric> coeffs;
+  numeric cst;
+  if (not linear(expand(ineq), coeffs, cst))
+    return false;
+  for (auto it = coeffs.begin(); it != coeffs.end();) {
+    if (it->second.is_zero())
+      it = coeffs.erase(it);
+    else
+      it++;
+  }
+  if (coeffs.empty()) {
+    if (cst.is_negative())
+      isEmpty = true;
+    return true;
+  }
+  linears.push_back({coeffs, cst});
+  return true;
+}
+
+bool IntegerBox::propagate(const gexmap<numeric> &coeffs, const numeric &cst) {
+  bool changed = false;
+  for (const auto &target : coeffs) {
+    // a_j * x_j >= -cst - sum_{i != j} max(a_i * x_i)
+    numeric rhs = -cst;
+    bool bounded = true;
+    for (const auto &other : coeffs) {
+      if (other.first.is_equal(target.first))
+        continue;
+      auto b = bounds.find(other.first);
+      if (b == bounds.end()) {
+        bounded = false;
+        break;
+      }
+      const Interval &I = b->second;
+      if (other.second.is_positive()) {
+        if (not I.hasHi) {
+          bounded = false;
+          break;
+        }
+        rhs -= other.second * I.hi;
+      } else {
+        if (not I.hasLo) {
+          bounded = false;
+          break;
+        }
+        rhs -= other.second * I.lo;
+      }
+    }
+    if (not bounded)
+      continue;
+    Interval &I = bounds[target.first];
+    if (target.second.is_positive())
+      changed |= I.tightenLo(ceilq(rhs / target.second));
+    else
+      changed |= I.tightenHi(floorq(rhs / target.second));
+    if (I.empty()) {
+      DEBUG(6, target.first << " has an empty interval\n");
+      isEmpty = true;
+      return false;
+    }
+  }
+  return changed;
+}
+
+void IntegerBox::propagate(unsigned rounds) {
+  for (bool changed = true; changed and rounds and not isEmpty; rounds--) {
+    changed = false;
+    for (const auto &l : linears)
+      changed |= propagate(l.first, l.second);
+  }
+  DEBUGFOR(7, const auto &b
+           : bounds, b.first << " in [" << (b.second.hasLo ? b.second.lo : -999)
+                             << ", " << (b.second.hasHi ? b.second.hi : 999)
+                             << "]\n");
+}
+
+Interval IntegerBox::get(const ex &s) const {
+  auto it = bounds.find(s);
+  if (it == bounds.end())
+    return Interval();
+  return it->second;
+}
+
+namespace univariate {
+
+static void trim(poly &p) {
+  while ((not p.empty()) and p.back().is_zero())
+    p.pop_back();
+}
+
+static numeric eval(const poly &p, const numeric &x) {
+  numeric r = 0;
+  for (auto it = p.rbegin(); it != p.rend(); it++)
+    r = r * x + *it;
+  return r;
+}
+
+static poly derive(const poly &p) {
+  poly d;
+  for (size_t i = 1; i < p.size(); i++)
+    d.push_back(p[i] * numeric(i));
+  trim(d);
+  return d;
+}
+
+// Polynomial division a = q * b + r, in exact rational arithmetic
+static void divide(poly a, const poly &b, poly &q, poly &r) {
+  trim(a);
+  q.assign(a.size() >= b.size() ? a.size() - b.size() + 1 : 0, 0);
+  while ((not a.empty()) and (a.size() >= b.size())) {
+    const size_t shift = a.size() - b.size();
+    const numeric f = a.back() / b.back();
+    q[shift] = f;
+    for (size_t i = 0; i < b.size(); i++)
+      a[i + shift] -= f * b[i];
+    a.pop_back(); // Exactly zero now
+    trim(a);
+  }
+  r = a;
+}
+
+static poly gcd(poly a, poly b) {
+  trim(a);
+  trim(b);
+  while (not b.empty()) {
+    poly q, r;
+    divide(a, b, q, r);
+    a = b;
+    b = r;
+  }
+  if (a.empty())
+    return a;
+  const numeric lc = a.back();
+  for (numeric &c : a)
+    c = c / lc;
+  return a;
+}
+
+// Squarefree part, p / gcd(p, p'), has the same distinct roots as p
+static poly squarefree(const poly &p) {
+  poly g = gcd(p, derive(p));
+  if (g.size() <= 1)
+    return p;
+  poly q, r;
+  divide(p, g, q, r);
+  trim(q);
+  return q;
+}
+
+static vector<poly> sturm(const poly &p) {
+  vector<poly> seq = {p, derive(p)};
+  while (seq.back().size() > 1) {
+    poly q, r;
+    divide(seq[seq.size() - 2], seq.back(), q, r);
+    if (r.empty())
+      break;
+    for (numeric &c : r)
+      c = -c;
+    seq.push_back(r);
+  }
+  return seq;
+}
+
+static unsigned variations(const vector<poly> &seq, const numeric &x) {
+  unsigned v = 0;
+  int last = 0;
+  for (const poly &p : seq) {
+    numeric val = eval(p, x);
+    if (val.is_zero())
+      continue;
+    int s = val.is_positive() ? 1 : -1;
+    if (last and (s != last))
+      v++;
+    last = s;
+  }
+  return v;
+}
+
+// All real roots of p are in the open interval (-B, B)
+static numeric cauchy(const poly &p) {
+  numeric m = 0;
+  for (size_t i = 0; i + 1 < p.size(); i++)
+    m = max(m, abs(p[i] / p.back()));
+  return ceilq(m) + 1;
+}
+
+// Push the integer cells [k, k + 1] holding the roots in (L, H]
+static void isolate(const vector<poly> &seq, const numeric &L,
+                    const numeric &H, vector<numeric> &points) {
+  if (variations(seq, L) == variations(seq, H))
+    return;
+  if (H - L == 1) {
+    points.push_back(L);
+    points.push_back(H);
+    return;
+  }
+  const numeric mid = L + iquo(H - L, 2);
+  isolate(seq, L, mid, points);
+  isolate(seq, mid, H, points);
+}
+
+bool get(const ex &e, ex &x, poly &p) {
+  bool found = false;
+  for (ex::const_preorder_iterator i = e.preorder_begin(),
+                                   iEnd = e.preorder_end();
+       i != iEnd; ++i) {
+    if (not is_a<symbol>(*i))
+      continue;
+    if (not found) {
+      x = *i;
+      found = true;
+    } else if (not x.is_equal(*i))
+      return false;
+  }
+  if ((not found) or (e.ldegree(x) < 0))
+    return false;
+
+  p.assign(e.degree(x) + 1, 0);
+  for (size_t k = 0; k < p.size(); k++) {
+    ex c = e.coeff(x, k);
+    if ((not is_a<numeric>(c)) or (not ex_to<numeric>(c).is_rational()))
+      return false;
+    p[k] = ex_to<numeric>(c);
+  }
+  trim(p);
+  return true;
+}
+
+testResult sign(const poly &pIn, const Interval &dom) {
+  poly p = pIn;
+  trim(p);
+  if (p.empty())
+    return {SIGN::ZERO, 0.0};
+  if (dom.empty())
+    return {SIGN::UNKNOWN, 0.0};
+
+  /* Points where the extreme values of p might be: the interval ends, and the
+   * integer cells holding the real roots of p' */
+  vector<numeric> points;
+  if (dom.hasLo)
+    points.push_back(dom.lo);
+  if (dom.hasHi)
+    points.push_back(dom.hi);
+
+  const size_t deg = p.size() - 1;
+  if (deg >= 2) {
+    const poly sq = squarefree(derive(p));
+    const numeric B = cauchy(sq);
+    const numeric L = dom.hasLo ? max(dom.lo, -B) : -B;
+    const numeric H = dom.hasHi ? min(dom.hi, B) : B;
+    if (L <= H) {
+      points.push_back(L);
+      points.push_back(H);
+      if (L < H)
+        isolate(sturm(sq), L, H, points);
+    }
+  }
+  if (points.empty())
+    return {SIGN::UNKNOWN, 0.0};
+
+  numeric minV = eval(p, points.front()), maxV = minV;
+  for (const numeric &x : points) {
+    const numeric v = eval(p, x);
+    minV = min(minV, v);
+    maxV = max(maxV, v);
+  }
+
+  // Beyond the points, p is monotone and goes to +/- infinity
+  bool minInf = false, maxInf = false;
+  const bool lcPositive = p.back().is_positive();
+  if (not dom.hasHi)
+    (lcPositive ? maxInf : minInf) = true;
+  if (not dom.hasLo)
+    ((lcPositive == (deg % 2 == 0)) ? maxInf : minInf) = true;
+
+  DEBUG(7, "Univariate extreme values: [" << (minInf ? "-inf" : "") << minV
+                                          << ", " << (maxInf ? "+inf" : "")
+                                          << maxV << "]\n");
+  if ((not minInf) and minV.is_positive())
+    return {SIGN::GTZ, minV.to_double()};
+  if ((not maxInf) and maxV.is_negative())
+    return {SIGN::LTZ, -maxV.to_double()};
+  if ((not minInf) and (not maxInf) and minV.is_zero() and maxV.is_zero())
+    return {SIGN::ZERO, 0.0};
+  if ((not minInf) and minV.is_zero())
+    return {SIGN::GEZ, 0.0};
+  if ((not maxInf) and maxV.is_zero())
+    return {SIGN::LEZ, 0.0};
+  return {SIGN::UNKNOWN, 0.0};
+}
+} // namespace univariate
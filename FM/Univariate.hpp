@@ -0,0 +1,65 @@
+#pragma once
+#ifndef _UNIVARIATE_HPP_
+#define _UNIVARIATE_HPP_
+
+#include "Schweighofer.hpp"
+#include <ginac/ginac.h>
+#include <vector>
+
+using namespace std;
+using namespace GiNaC;
+
+/* Integer interval [lo, hi] a symbol is implied to live in. Any side might be
+ * unbounded. */
+struct Interval {
+  bool hasLo = false, hasHi = false;
+  numeric lo, hi;
+
+  bool empty() const { return hasLo and hasHi and (lo > hi); }
+  bool tightenLo(const numeric &l);
+  bool tightenHi(const numeric &h);
+};
+
+/* The IntegerBox keeps, for each symbol, the tightest integer interval implied
+ * by the linear constraints of a system. Bounds are propagated from one
+ * constraint to the others, so 1 <= i & i + 2 <= n gives 3 <= n. As all our
+ * symbols are integers, every bound is rounded towards the inside of the
+ * interval. */
+class IntegerBox {
+public:
+  IntegerBox() {}
+  IntegerBox(const exset &ineqs, unsigned rounds = 16);
+
+  // Add a linear constraint E >= 0 to the box, returns false if E is not
+  // affine with numeric coefficients
+  bool insert(const ex &ineq);
+  // Propagate the bounds among the inserted constraints
+  void propagate(unsigned rounds = 16);
+  bool empty() const { return isEmpty; }
+  Interval get(const ex &s) const;
+  const gexmap<Interval> &getBounds() const { return bounds; }
+
+  static bool linear(const ex &e, gexmap<numeric> &coeffs, numeric &cst);
+
+private:
+  bool propagate(const gexmap<numeric> &coeffs, const numeric &cst);
+  vector<pair<gexmap<numeric>, numeric>> linears;
+  gexmap<Interval> bounds;
+  bool isEmpty = false;
+};
+
+/* Exact sign of an univariate polynomial p(x) with rational coefficients over
+ * the integers of an interval. The real roots of p' are isolated by Sturm
+ * sequences, in exact arithmetic, down to integer cells. Between two such
+ * cells p is monotone, so its extreme values over the integers of the interval
+ * are attained at the cells borders or at the interval ends. If the
+ * extreme values do not decide the sign, UNKNOWN is returned. */
+namespace univariate {
+typedef vector<numeric> poly; // poly[i] is the coefficient of x^i
+
+// Returns true if e is a polynomial in a single symbol, filling x and p
+bool get(const ex &e, ex &x, poly &p);
+testResult sign(const poly &p, const Interval &dom);
+} // namespace univariate
+
+#endif //_UNIVARIATE_HPP_
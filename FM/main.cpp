@@ -1,4 +1,8 @@
 #include "Disjunction.hpp"
+#include "Parallel.hpp"
+#include "Planner.hpp"
+#include "Schweighofer.hpp"
+#include "Stats.hpp"
 #include <fstream>
 
 using namespace std;
@@ -10,9 +14,42 @@ int main(int argc, char *argv[]) {
   Disjunction sys;
   bool cPrint = false;
   int startFrom = 1;
-  if (argc != 1 and (!strcmp("-c", argv[1]))) {
-    cPrint = true;
-    startFrom = 2;
+  /* Options are a dash and a letter. Anything else, such as a system
+   * starting with -i, ends them, and so does -- */
+  for (; (startFrom < argc) and (argv[startFrom][0] == '-') and
+         (strlen(argv[startFrom]) == 2);
+       startFrom++) {
+    if (!strcmp("--", argv[startFrom])) {
+      startFrom++;
+      break;
+    } else if (!strcmp("-c", argv[startFrom]))
+      cPrint = true;
+    else if (!strcmp("-s", argv[startFrom]))
+      stats::enabled = true;
+    else if (!strcmp("-q", argv[startFrom]))
+      SchweighoferTester::squareGenerators = true;
+    else if (!strcmp("-t", argv[startFrom]) and (startFrom + 1 < argc))
+      SchweighoferTester::snapshotDir = argv[++startFrom];
+    else if (!strcmp("-j", argv[startFrom]) and (startFrom + 1 < argc) and
+             (atoi(argv[startFrom + 1]) > 0))
+      parallel::jobs = atoi(argv[++startFrom]);
+    else if (!strcmp("-p", argv[startFrom]) and (startFrom + 1 < argc) and
+             planner::parse(argv[startFrom + 1]))
+      startFrom++;
+    else {
+      cerr << "Unknown option " << argv[startFrom]
+           << "\nUsage: " << argv[0]
+           << " [-c] [-s] [-q] [-t dir] [-j jobs] [-p planner] [--] [system "
+              "| files...]\n"
+              "\t-c: print the result as a C condition\n"
+              "\t-s: print statistics to stderr\n"
+              "\t-q: add squares of symbols as non-negative generators\n"
+              "\t-t: load and save the testers snapshots in dir\n"
+              "\t-j: number of worker processes, 1 by default\n"
+              "\t-p: elimination order planner, greedy (default), cost or "
+              "lookahead\n";
+      return 1;
+    }
   }
   if (startFrom == argc) {
     cerr << "Reading from console / stdin\n\n";
@@ -38,14 +75,19 @@ int main(int argc, char *argv[]) {
     }
   }
   sys.eliminateVariables();
-  sys.simplifyFactor();
+  // Drop the absurd and repeated disjuncts before the pairwise LP tests
+  sys.removeDuplicates();
+  sys.coalesce();
   sys.removeImplicators();
+  sys.simplifyFactor();
   DEBUG(1, "End system is:\n" << sys << NL);
   if (cPrint) {
     sys.c_print(cout);
   } else {
     cout << sys << NL;
   }
+  if (stats::enabled)
+    stats::print(cerr);
   return 0;
 }
 #else